@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+#include "admission.h"
+#include "sync.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest limit, since blocking admission counts the room left with a
+semaphore */
+#if SEM_VALUE_MAX < INT_MAX
+#define LIMIT_MAX SEM_VALUE_MAX
+#else
+#define LIMIT_MAX INT_MAX
+#endif
+
+/* Parses "N" (the same limit for every role) or "S:I:D", returns -1 if spec
+is invalid or a limit is over LIMIT_MAX */
+int admission_parse_limits(const char *spec, size_t limit[3]) {
+  const char *cur = spec;
+
+  for (int i = 0; i < 3; i++) {
+    char *end;
+    unsigned long long n = strtoull(cur, &end, 10);
+    if (end == cur || cur[0] == '-' || n > LIMIT_MAX) {
+      return -1;
+    }
+    limit[i] = (size_t)n;
+    if (i == 0 && *end == '\0') {
+      limit[1] = limit[2] = limit[0];
+      return 0;
+    }
+    if ((i < 2 && *end != ':') || (i == 2 && *end != '\0')) {
+      return -1;
+    }
+    cur = end + 1;
+  }
+  return 0;
+}
+
+/* Parses reject, block or drop-oldest, returns -1 if spec is invalid */
+int admission_parse_policy(const char *spec, overload_policy *policy) {
+  if (strcmp(spec, "reject") == 0) {
+    *policy = OVERLOAD_REJECT;
+  } else if (strcmp(spec, "block") == 0) {
+    *policy = OVERLOAD_BLOCK;
+  } else if (strcmp(spec, "drop-oldest") == 0) {
+    *policy = OVERLOAD_DROP_OLDEST;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+void admission_init(admission *a, overload_policy policy,
+                    const size_t limit[3]) {
+  a->policy = policy;
+  mutex_new(&a->lock);
+  for (int r = 0; r < 3; r++) {
+    a->limit[r] = limit[r];
+    atomic_init(&a->queued[r], 0);
+    atomic_init(&a->rejected[r], 0);
+    atomic_init(&a->dropped[r], 0);
+    a->oldest[r] = NULL;
+    a->newest[r] = NULL;
+    /* A role without a limit never waits for room */
+    if (policy == OVERLOAD_BLOCK && limit[r] != 0) {
+      sem_new(&a->room[r], (int)limit[r]);
+    }
+  }
+}
+
+static void unref(admission_ticket *ticket) {
+  if (atomic_fetch_sub(&ticket->refs, 1) == 1) {
+    free(ticket);
+  }
+}
+
+/* Must only be called once every admitted operation is done */
+void admission_destroy(admission *a) {
+  for (int r = 0; r < 3; r++) {
+    while (a->oldest[r] != NULL) {
+      admission_ticket *next = a->oldest[r]->next;
+      unref(a->oldest[r]);
+      a->oldest[r] = next;
+    }
+    if (a->policy == OVERLOAD_BLOCK && a->limit[r] != 0) {
+      sem_destroy(&a->room[r]);
+    }
+  }
+  pthread_mutex_destroy(&a->lock);
+}
+
+/* Drops the oldest operation of role which didn't start yet, returns -1 if
+they all did. Must be called with the lock held */
+static int drop_oldest(admission *a, worker_role role) {
+  while (a->oldest[role] != NULL) {
+    admission_ticket *ticket = a->oldest[role];
+    a->oldest[role] = ticket->next;
+    if (a->oldest[role] == NULL) {
+      a->newest[role] = NULL;
+    }
+
+    int expected = TICKET_PENDING;
+    int dropped = atomic_compare_exchange_strong(&ticket->state, &expected,
+                                                 TICKET_DROPPED);
+    unref(ticket);
+    if (dropped) {
+      atomic_fetch_sub(&a->queued[role], 1);
+      atomic_fetch_add(&a->dropped[role], 1);
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/*
+Called by the producer before issuing an operation of role. Returns 0 if it
+may be issued, in which case ticket must be passed on to admission_start and
+admission_done (it's NULL unless the policy is OVERLOAD_DROP_OLDEST), and -1
+if it was rejected.
+*/
+int admission_admit(admission *a, worker_role role,
+                    admission_ticket **ticket) {
+  size_t limit = a->limit[role];
+  *ticket = NULL;
+
+  if (limit == 0) {
+    atomic_fetch_add(&a->queued[role], 1);
+    return 0;
+  }
+
+  switch (a->policy) {
+  case OVERLOAD_REJECT:
+    if (atomic_fetch_add(&a->queued[role], 1) >= limit) {
+      atomic_fetch_sub(&a->queued[role], 1);
+      atomic_fetch_add(&a->rejected[role], 1);
+      return -1;
+    }
+    return 0;
+  case OVERLOAD_BLOCK:
+    sem_acquire(&a->room[role]);
+    atomic_fetch_add(&a->queued[role], 1);
+    return 0;
+  case OVERLOAD_DROP_OLDEST:
+    break;
+  }
+
+  mutex_acquire(&a->lock);
+  /* Forget the tickets of operations that already started */
+  while (a->oldest[role] != NULL &&
+         atomic_load(&a->oldest[role]->state) != TICKET_PENDING) {
+    admission_ticket *started = a->oldest[role];
+    a->oldest[role] = started->next;
+    unref(started);
+  }
+  if (a->oldest[role] == NULL) {
+    a->newest[role] = NULL;
+  }
+
+  if (atomic_load(&a->queued[role]) >= limit && drop_oldest(a, role) < 0) {
+    /* Every queued operation is already waiting for the list */
+    mutex_release(&a->lock);
+    atomic_fetch_add(&a->rejected[role], 1);
+    return -1;
+  }
+
+  admission_ticket *t = malloc(sizeof(*t));
+  t->next = NULL;
+  atomic_init(&t->state, TICKET_PENDING);
+  /* One reference for the queue and one for the operation */
+  atomic_init(&t->refs, 2);
+  if (a->newest[role] == NULL) {
+    a->oldest[role] = t;
+  } else {
+    a->newest[role]->next = t;
+  }
+  a->newest[role] = t;
+  atomic_fetch_add(&a->queued[role], 1);
+  mutex_release(&a->lock);
+
+  *ticket = t;
+  return 0;
+}
+
+/* Called by the worker before entering the acquire path. Returns -1 if the
+operation was dropped, in which case it must not run nor call admission_done */
+int admission_start(admission_ticket *ticket) {
+  if (ticket == NULL) {
+    return 0;
+  }
+  int expected = TICKET_PENDING;
+  if (!atomic_compare_exchange_strong(&ticket->state, &expected,
+                                      TICKET_STARTED)) {
+    unref(ticket);
+    return -1;
+  }
+  return 0;
+}
+
+/* Called by the worker once its operation is done */
+void admission_done(admission *a, worker_role role, admission_ticket *ticket) {
+  atomic_fetch_sub(&a->queued[role], 1);
+  if (a->policy == OVERLOAD_BLOCK && a->limit[role] != 0) {
+    sem_release(&a->room[role]);
+  }
+  if (ticket != NULL) {
+    unref(ticket);
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef _ADMISSION_INCLUDE_H
+#define _ADMISSION_INCLUDE_H
+
+#include "events.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef enum {
+  /* Operations over the limit are rejected */
+  OVERLOAD_REJECT,
+  /* The producer waits until there is room */
+  OVERLOAD_BLOCK,
+  /* The oldest operation that didn't start yet is dropped to make room */
+  OVERLOAD_DROP_OLDEST,
+} overload_policy;
+
+typedef enum {
+  TICKET_PENDING,
+  TICKET_STARTED,
+  TICKET_DROPPED,
+} ticket_state;
+
+/* Shared by the producer's queue of pending operations and the operation
+itself, whoever drops the last reference frees it */
+typedef struct admission_ticket {
+  struct admission_ticket *next;
+  atomic_int state;
+  atomic_int refs;
+} admission_ticket;
+
+/*
+Bounds the number of queued operations of each role, i.e. operations that were
+issued but aren't done yet, whether they are still in the pool's deques or
+waiting for the semaphores. The limit is enforced by the producer before
+issuing an operation, so under overload operations are turned away instead of
+piling up in the waiting queues. A limit of 0 means no limit for that role.
+
+With OVERLOAD_DROP_OLDEST every operation gets a ticket, and workers call
+admission_start before entering the acquire path, which fails if the producer
+dropped the operation in the meantime.
+*/
+typedef struct admission {
+  overload_policy policy;
+  size_t limit[3];
+  atomic_size_t queued[3];
+  /* Free room of each role, only used with OVERLOAD_BLOCK */
+  sem_t room[3];
+  /* Tickets of each role in issue order, only used with OVERLOAD_DROP_OLDEST */
+  pthread_mutex_t lock;
+  admission_ticket *oldest[3];
+  admission_ticket *newest[3];
+  atomic_size_t rejected[3];
+  atomic_size_t dropped[3];
+} admission;
+
+int admission_parse_limits(const char *spec, size_t limit[3]);
+int admission_parse_policy(const char *spec, overload_policy *policy);
+void admission_init(admission *a, overload_policy policy,
+                    const size_t limit[3]);
+void admission_destroy(admission *a);
+int admission_admit(admission *a, worker_role role,
+                    admission_ticket **ticket);
+int admission_start(admission_ticket *ticket);
+void admission_done(admission *a, worker_role role, admission_ticket *ticket);
+
+#endif
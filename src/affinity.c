@@ -0,0 +1,282 @@
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  int cpu;
+  long package;
+  long core;
+  /* Index of the CPU among the SMT siblings of its core */
+  size_t smt;
+  /* Index of the core among the cores of its package */
+  size_t core_rank;
+} cpu_info;
+
+/* Reads a single number from a sysfs topology file, returns fallback if it
+can't be read */
+static long read_topology(int cpu, const char *name, long fallback) {
+  char path[128];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s",
+           cpu, name);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return fallback;
+  }
+  long value;
+  if (fscanf(f, "%ld", &value) != 1) {
+    value = fallback;
+  }
+  fclose(f);
+  return value;
+}
+
+/* Lists the CPUs the process may run on along with their topology, returns
+how many there are */
+static size_t online_cpus(cpu_info **out) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+    perror("Couldn't get the CPUs of the process");
+    *out = NULL;
+    return 0;
+  }
+
+  size_t n = (size_t)CPU_COUNT(&set);
+  cpu_info *cpus = calloc(n + 1, sizeof(*cpus));
+  size_t len = 0;
+  for (int cpu = 0; cpu < CPU_SETSIZE && len < n; cpu++) {
+    if (CPU_ISSET((size_t)cpu, &set)) {
+      cpus[len].cpu = cpu;
+      cpus[len].package = read_topology(cpu, "physical_package_id", 0);
+      cpus[len].core = read_topology(cpu, "core_id", cpu);
+      len++;
+    }
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    for (size_t j = 0; j < len; j++) {
+      if (cpus[j].package != cpus[i].package) {
+        continue;
+      }
+      if (cpus[j].core == cpus[i].core && cpus[j].cpu < cpus[i].cpu) {
+        cpus[i].smt++;
+      }
+      /* Count each smaller core once, through its first sibling */
+      if (cpus[j].core < cpus[i].core) {
+        int first = 1;
+        for (size_t k = 0; k < j; k++) {
+          if (cpus[k].package == cpus[j].package &&
+              cpus[k].core == cpus[j].core) {
+            first = 0;
+            break;
+          }
+        }
+        cpus[i].core_rank += (size_t)first;
+      }
+    }
+  }
+
+  *out = cpus;
+  return len;
+}
+
+static int cmp_long(long a, long b) { return (a > b) - (a < b); }
+
+static int cmp_size(size_t a, size_t b) { return (a > b) - (a < b); }
+
+static int compact_order(const void *a, const void *b) {
+  const cpu_info *x = a;
+  const cpu_info *y = b;
+  int c = cmp_long(x->package, y->package);
+  if (c == 0) {
+    c = cmp_size(x->core_rank, y->core_rank);
+  }
+  return c != 0 ? c : x->cpu - y->cpu;
+}
+
+static int scatter_order(const void *a, const void *b) {
+  const cpu_info *x = a;
+  const cpu_info *y = b;
+  int c = cmp_size(x->smt, y->smt);
+  if (c == 0) {
+    c = cmp_size(x->core_rank, y->core_rank);
+  }
+  if (c == 0) {
+    c = cmp_long(x->package, y->package);
+  }
+  return c != 0 ? c : x->cpu - y->cpu;
+}
+
+/* Parses "N,N-M,..." into a->cpus, every CPU must be usable by the process */
+static int parse_cpu_list(const char *list, affinity *a, const cpu_info *online,
+                          size_t nonline) {
+  size_t cap = 16;
+  a->cpus = calloc(cap, sizeof(int));
+  a->ncpus = 0;
+
+  const char *cur = list;
+  for (;;) {
+    char *end;
+    long lo = strtol(cur, &end, 10);
+    long hi = lo;
+    if (end == cur || lo < 0) {
+      return -1;
+    }
+    if (*end == '-') {
+      cur = end + 1;
+      hi = strtol(cur, &end, 10);
+      if (end == cur || hi < lo) {
+        return -1;
+      }
+    }
+
+    for (long cpu = lo; cpu <= hi; cpu++) {
+      int usable = 0;
+      for (size_t i = 0; i < nonline; i++) {
+        usable |= online[i].cpu == cpu;
+      }
+      if (!usable) {
+        fprintf(stderr, "CPU %ld is not available to this process\n", cpu);
+        return -1;
+      }
+      if (a->ncpus == cap) {
+        cap *= 2;
+        a->cpus = realloc(a->cpus, cap * sizeof(int));
+      }
+      a->cpus[a->ncpus++] = (int)cpu;
+    }
+
+    if (*end == '\0') {
+      return 0;
+    }
+    if (*end != ',') {
+      return -1;
+    }
+    cur = end + 1;
+  }
+}
+
+void affinity_none(affinity *a) {
+  a->policy = AFFINITY_NONE;
+  a->spec = "none";
+  a->cpus = NULL;
+  a->ncpus = 0;
+  a->split = 0;
+}
+
+/*
+Parses a placement policy, one of:
+
+- none
+- compact
+- scatter
+- list:CPUS, e.g. list:0,2,4-7
+- split
+
+Returns -1 if spec is invalid or names CPUs the process can't use.
+*/
+int affinity_parse(const char *spec, affinity *a) {
+  affinity_none(a);
+  if (strcmp(spec, "none") == 0) {
+    return 0;
+  }
+
+  cpu_info *online;
+  size_t n = online_cpus(&online);
+  if (n == 0) {
+    free(online);
+    return -1;
+  }
+
+  int ret = 0;
+  if (strcmp(spec, "compact") == 0 || strcmp(spec, "split") == 0) {
+    qsort(online, n, sizeof(*online), compact_order);
+    a->policy = spec[0] == 'c' ? AFFINITY_COMPACT : AFFINITY_SPLIT;
+  } else if (strcmp(spec, "scatter") == 0) {
+    qsort(online, n, sizeof(*online), scatter_order);
+    a->policy = AFFINITY_SCATTER;
+  } else if (strncmp(spec, "list:", 5) == 0) {
+    a->policy = AFFINITY_LIST;
+    ret = parse_cpu_list(spec + 5, a, online, n);
+  } else {
+    ret = -1;
+  }
+
+  if (ret == 0 && a->policy != AFFINITY_LIST) {
+    a->cpus = calloc(n, sizeof(int));
+    a->ncpus = n;
+    for (size_t i = 0; i < n; i++) {
+      a->cpus[i] = online[i].cpu;
+    }
+  }
+
+  /* Split at a core boundary, so searchers and writers never share a core.
+  With a single core both groups get every CPU */
+  if (ret == 0 && a->policy == AFFINITY_SPLIT) {
+    size_t split = n / 2;
+    while (split > 0 &&
+           online[split].core_rank == online[split - 1].core_rank &&
+           online[split].package == online[split - 1].package) {
+      split--;
+    }
+    a->split = split;
+  }
+  free(online);
+
+  if (ret < 0) {
+    affinity_free(a);
+    return -1;
+  }
+  a->spec = spec;
+  return 0;
+}
+
+void affinity_free(affinity *a) {
+  free(a->cpus);
+  affinity_none(a);
+}
+
+/* Sets the CPU of the given pool thread in attr. Returns 1 if it was set and
+0 if the thread isn't pinned when created */
+int affinity_attr(const affinity *a, size_t thread, pthread_attr_t *attr) {
+  if (a->policy == AFFINITY_NONE || a->policy == AFFINITY_SPLIT ||
+      a->ncpus == 0) {
+    return 0;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET((size_t)a->cpus[thread % a->ncpus], &set);
+  int err = pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+  if (err != 0) {
+    fprintf(stderr, "Couldn't set thread affinity: %s\n", strerror(err));
+    return 0;
+  }
+  return 1;
+}
+
+/* Pins the calling thread to the CPUs of searchers or writers, only meaningful
+for AFFINITY_SPLIT. Returns -1 on failure */
+int affinity_pin_group(const affinity *a, int writers) {
+  size_t lo = 0;
+  size_t hi = a->ncpus;
+  if (a->split != 0) {
+    lo = writers ? a->split : 0;
+    hi = writers ? a->ncpus : a->split;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t i = lo; i < hi; i++) {
+    CPU_SET((size_t)a->cpus[i], &set);
+  }
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (err != 0) {
+    fprintf(stderr, "Couldn't set thread affinity: %s\n", strerror(err));
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef _AFFINITY_INCLUDE_H
+#define _AFFINITY_INCLUDE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+typedef enum {
+  /* Threads are left wherever the OS puts them */
+  AFFINITY_NONE,
+  /* Fill every hardware thread of a core before moving to the next core */
+  AFFINITY_COMPACT,
+  /* Spread threads over packages and cores before using SMT siblings */
+  AFFINITY_SCATTER,
+  /* Threads go round-robin over an explicit list of CPUs */
+  AFFINITY_LIST,
+  /* Searchers run on one half of the cores and writers on the other */
+  AFFINITY_SPLIT,
+} affinity_policy;
+
+/*
+Placement of the pool threads on CPUs.
+
+cpus holds the CPUs the process may run on, in the order threads are placed on
+them, so thread i is pinned to cpus[i % ncpus]. The order is computed from the
+topology in /sys/devices/system/cpu when the policy is parsed.
+
+With AFFINITY_SPLIT threads aren't pinned when they are created. Instead, a
+pool thread pins itself to cpus[0, split) before running a searcher and to
+cpus[split, ncpus) before running an inserter or a deleter, which only costs a
+system call when it switches between the two.
+*/
+typedef struct {
+  affinity_policy policy;
+  /* The policy as given, printed in the results of a run */
+  const char *spec;
+  int *cpus;
+  size_t ncpus;
+  size_t split;
+} affinity;
+
+void affinity_none(affinity *a);
+int affinity_parse(const char *spec, affinity *a);
+void affinity_free(affinity *a);
+int affinity_attr(const affinity *a, size_t thread, pthread_attr_t *attr);
+int affinity_pin_group(const affinity *a, int writers);
+
+#endif
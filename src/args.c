@@ -0,0 +1,23 @@
+#include "args.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+size_t args_parse_size(const char *arg, const char *name) {
+  char *end;
+  unsigned long long n = strtoull(arg, &end, 10);
+  if (end == arg || *end != '\0' || arg[0] == '-') {
+    fprintf(stderr, "Invalid %s: %s\n", name, arg);
+    exit(1);
+  }
+  return (size_t)n;
+}
+
+double args_parse_double(const char *arg, const char *name) {
+  char *end;
+  double n = strtod(arg, &end);
+  if (end == arg || *end != '\0' || n < 0) {
+    fprintf(stderr, "Invalid %s: %s\n", name, arg);
+    exit(1);
+  }
+  return n;
+}
@@ -0,0 +1,11 @@
+#ifndef _ARGS_INCLUDE_H
+#define _ARGS_INCLUDE_H
+
+#include <stddef.h>
+
+/* Parse a command line value, name is what it's called in the error printed
+before exiting if arg isn't a valid non-negative number */
+size_t args_parse_size(const char *arg, const char *name);
+double args_parse_double(const char *arg, const char *name);
+
+#endif
@@ -0,0 +1,348 @@
+#define _GNU_SOURCE
+#include "args.h"
+#include "sched.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Runs a workload once for every combination of thread count and initial list
+size, without printing the state, and writes one CSV row per role with the
+throughput and latency percentiles of each run.
+*/
+
+#define MAX_SWEEP 32
+
+static const char *role_names[] = {"search", "insert", "delete"};
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [options]\n", prog);
+  fprintf(stderr, "  --threads N,N,...   thread counts to sweep (default "
+                  "1,2,4,8)\n");
+  fprintf(stderr, "  --sizes N,N,...     initial list sizes to sweep (default "
+                  "10,100,1000)\n");
+  fprintf(stderr, "  --range N           keys are drawn from [1, N] (default "
+                  "twice the list size)\n");
+  fprintf(stderr, "  --payload BYTES     store BYTES of payload inline in "
+                  "every node (default none)\n");
+  fprintf(stderr, "  --lists N           spread the operations over N "
+                  "independent lists (default 1)\n");
+  fprintf(stderr, "  --sorted            keep the list sorted\n");
+  fprintf(stderr, "  --counted           store duplicates as a count on a "
+                  "single node\n");
+  fprintf(stderr, "  --dense N           count keys in an array while they "
+                  "span at most N values\n");
+  fprintf(stderr, "  --organize POLICY   move found keys forward: none, "
+                  "move-to-front or transpose\n");
+  fprintf(stderr, "  --mix S:I:D         percentage of searches, inserts and "
+                  "deletes (default 34:33:33)\n");
+  fprintf(stderr, "  --keys DIST         uniform, zipfian[:THETA], "
+                  "hotspot[:HOT_KEYS:HOT_OPS] or sequential\n");
+  fprintf(stderr, "  --background S:I:D  percentage of each role issued as "
+                  "background operations (default 0:0:0)\n");
+  fprintf(stderr, "  --ops N             operations per run (default "
+                  "10000)\n");
+  fprintf(stderr, "  --duration SECS     run for SECS seconds instead, after "
+                  "the warmup\n");
+  fprintf(stderr, "  --warmup SECS       leave the first SECS seconds of every "
+                  "run out of the results (default 0)\n");
+  fprintf(stderr, "  --seed N            seed of every run (default 1)\n");
+  fprintf(stderr, "  --coroutines        run the operations as coroutines\n");
+  fprintf(stderr, "  --affinity POLICY   pin the pool threads: none, compact, "
+                  "scatter, list:CPUS or split (default none)\n");
+  fprintf(stderr, "  --batch-searches    answer concurrent searches with "
+                  "shared traversals\n");
+  fprintf(stderr, "  --queue-limit N|S:I:D  most operations of each role "
+                  "issued but not done (default no limit)\n");
+  fprintf(stderr, "  --overload POLICY   reject, block or drop-oldest "
+                  "(default reject)\n");
+  fprintf(stderr, "  -s, -i, -d WORK     work done by searchers, inserters and "
+                  "deleters (default none)\n");
+}
+
+enum {
+  OPT_THREADS = 256,
+  OPT_SIZES,
+  OPT_RANGE,
+  OPT_MIX,
+  OPT_PAYLOAD,
+  OPT_LISTS,
+  OPT_SORTED,
+  OPT_COUNTED,
+  OPT_DENSE,
+  OPT_ORGANIZE,
+  OPT_KEYS,
+  OPT_BACKGROUND,
+  OPT_OPS,
+  OPT_DURATION,
+  OPT_WARMUP,
+  OPT_SEED,
+  OPT_AFFINITY,
+  OPT_COROUTINES,
+  OPT_BATCH_SEARCHES,
+  OPT_QUEUE_LIMIT,
+  OPT_OVERLOAD,
+};
+
+static const struct option options[] = {
+    {"threads", required_argument, NULL, OPT_THREADS},
+    {"sizes", required_argument, NULL, OPT_SIZES},
+    {"range", required_argument, NULL, OPT_RANGE},
+    {"mix", required_argument, NULL, OPT_MIX},
+    {"payload", required_argument, NULL, OPT_PAYLOAD},
+    {"lists", required_argument, NULL, OPT_LISTS},
+    {"sorted", no_argument, NULL, OPT_SORTED},
+    {"counted", no_argument, NULL, OPT_COUNTED},
+    {"dense", required_argument, NULL, OPT_DENSE},
+    {"organize", required_argument, NULL, OPT_ORGANIZE},
+    {"keys", required_argument, NULL, OPT_KEYS},
+    {"background", required_argument, NULL, OPT_BACKGROUND},
+    {"ops", required_argument, NULL, OPT_OPS},
+    {"duration", required_argument, NULL, OPT_DURATION},
+    {"warmup", required_argument, NULL, OPT_WARMUP},
+    {"seed", required_argument, NULL, OPT_SEED},
+    {"affinity", required_argument, NULL, OPT_AFFINITY},
+    {"coroutines", no_argument, NULL, OPT_COROUTINES},
+    {"batch-searches", no_argument, NULL, OPT_BATCH_SEARCHES},
+    {"queue-limit", required_argument, NULL, OPT_QUEUE_LIMIT},
+    {"overload", required_argument, NULL, OPT_OVERLOAD},
+    {"search-work", required_argument, NULL, 's'},
+    {"insert-work", required_argument, NULL, 'i'},
+    {"delete-work", required_argument, NULL, 'd'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0},
+};
+
+/* Parses a comma-separated list of positive integers into values, returns how
+many were read */
+static size_t parse_list(const char *arg, const char *name, size_t *values) {
+  size_t len = 0;
+  const char *cur = arg;
+
+  for (;;) {
+    char *end;
+    unsigned long long n = strtoull(cur, &end, 10);
+    if (end == cur || n == 0 || len == MAX_SWEEP ||
+        (*end != ',' && *end != '\0')) {
+      fprintf(stderr, "Invalid %s: %s\n", name, arg);
+      exit(1);
+    }
+    values[len++] = (size_t)n;
+    if (*end == '\0') {
+      return len;
+    }
+    cur = end + 1;
+  }
+}
+
+/* rejected and dropped are the operations which were turned away by the
+queue limits instead of running */
+static void print_row(const char *placement, size_t threads, size_t size,
+                      const char *role, const histogram *h,
+                      uint64_t elapsed_ns, size_t rejected, size_t dropped) {
+  printf("%s,%zu,%zu,%s,%llu,%.1f,%.1f,%llu,%llu,%llu,%llu,%zu,%zu\n",
+         placement, threads, size, role, (unsigned long long)h->count,
+         (double)h->count * 1e9 / (double)elapsed_ns, histogram_mean(h),
+         (unsigned long long)histogram_percentile(h, 50),
+         (unsigned long long)histogram_percentile(h, 99),
+         (unsigned long long)histogram_percentile(h, 99.9),
+         (unsigned long long)h->max, rejected, dropped);
+}
+
+int main(int argc, char **argv) {
+  workload wl;
+  size_t threads[MAX_SWEEP] = {1, 2, 4, 8};
+  size_t nthreads = 4;
+  size_t sizes[MAX_SWEEP] = {10, 100, 1000};
+  size_t nsizes = 3;
+  size_t range = 0;
+  work_model work[3];
+  affinity placement;
+  int coroutines = 0;
+  double warmup = 0;
+  int batch_searches = 0;
+  size_t queue_limit[3] = {0, 0, 0};
+  overload_policy overload = OVERLOAD_REJECT;
+  int opt;
+
+  workload_defaults(&wl);
+  wl.total_ops = 10000;
+  wl.seed = 1;
+  affinity_none(&placement);
+  for (int i = 0; i < 3; i++) {
+    work_parse("none", &work[i]);
+  }
+
+  while ((opt = getopt_long(argc, argv, "s:i:d:h", options, NULL)) != -1) {
+    switch (opt) {
+    case OPT_THREADS:
+      nthreads = parse_list(optarg, "thread counts", threads);
+      break;
+    case OPT_SIZES:
+      nsizes = parse_list(optarg, "list sizes", sizes);
+      break;
+    case OPT_RANGE:
+      range = args_parse_size(optarg, "range");
+      break;
+    case OPT_PAYLOAD:
+      wl.payload_size = args_parse_size(optarg, "payload size");
+      break;
+    case OPT_LISTS:
+      wl.lists = args_parse_size(optarg, "number of lists");
+      break;
+    case OPT_SORTED:
+      wl.sorted = 1;
+      break;
+    case OPT_COUNTED:
+      wl.counted = 1;
+      break;
+    case OPT_DENSE:
+      wl.dense_range = args_parse_size(optarg, "dense range");
+      break;
+    case OPT_ORGANIZE:
+      if (workload_parse_organize(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid organize policy: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_MIX:
+      if (workload_parse_mix(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid mix: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_KEYS:
+      if (workload_parse_keys(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid key distribution: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_BACKGROUND:
+      if (workload_parse_background(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid background mix: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_OPS:
+      wl.total_ops = args_parse_size(optarg, "number of operations");
+      break;
+    case OPT_DURATION:
+      wl.duration = args_parse_double(optarg, "duration");
+      wl.total_ops = 0;
+      break;
+    case OPT_WARMUP:
+      warmup = args_parse_double(optarg, "warmup");
+      break;
+    case OPT_SEED:
+      wl.seed = args_parse_size(optarg, "seed");
+      break;
+    case OPT_AFFINITY:
+      affinity_free(&placement);
+      if (affinity_parse(optarg, &placement) < 0) {
+        fprintf(stderr, "Invalid affinity policy: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_COROUTINES:
+      coroutines = 1;
+      break;
+    case OPT_BATCH_SEARCHES:
+      batch_searches = 1;
+      break;
+    case OPT_QUEUE_LIMIT:
+      if (admission_parse_limits(optarg, queue_limit) < 0) {
+        fprintf(stderr, "Invalid queue limit: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_OVERLOAD:
+      if (admission_parse_policy(optarg, &overload) < 0) {
+        fprintf(stderr, "Invalid overload policy: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 's':
+    case 'i':
+    case 'd': {
+      worker_role role = opt == 's'   ? ROLE_SEARCHER
+                         : opt == 'i' ? ROLE_INSERTER
+                                      : ROLE_DELETER;
+      if (work_parse(optarg, &work[role]) < 0) {
+        fprintf(stderr, "Invalid work model: %s\n", optarg);
+        return 1;
+      }
+      break;
+    }
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (wl.lists > 1 && batch_searches) {
+    fprintf(stderr, "Batched searches need a single list\n");
+    return 1;
+  }
+
+  printf("placement,threads,list_size,role,ops,throughput,mean_ns,p50_ns,"
+         "p99_ns,p999_ns,max_ns,rejected,dropped\n");
+
+  for (size_t s = 0; s < nsizes; s++) {
+    for (size_t t = 0; t < nthreads; t++) {
+      wl.initial_size = sizes[s];
+      wl.key_range = range != 0 ? range : 2 * sizes[s];
+      const char *err = workload_validate(&wl);
+      if (err != NULL) {
+        fprintf(stderr, "Invalid workload: %s\n", err);
+        return 1;
+      }
+
+      run_cfg run = run_cfg_new(&wl);
+      run.quiet = 1;
+      run.threads = threads[t];
+      run.placement = placement;
+      run.coroutines = coroutines;
+      run.warmup = warmup;
+      run.batch_searches = batch_searches;
+      run.overload = overload;
+      for (int r = 0; r < 3; r++) {
+        run.queue_limit[r] = queue_limit[r];
+      }
+      run.searchers.work = work[ROLE_SEARCHER];
+      run.inserters.work = work[ROLE_INSERTER];
+      run.deleters.work = work[ROLE_DELETER];
+      run_cfg_run(&run);
+
+      histogram all = {0};
+      size_t rejected = 0;
+      size_t dropped = 0;
+      for (int r = 0; r < 3; r++) {
+        size_t rej = atomic_load(&run.admission.rejected[r]);
+        size_t drop = atomic_load(&run.admission.dropped[r]);
+        print_row(placement.spec, threads[t], sizes[s], role_names[r],
+                  &run.latency[r], run.elapsed_ns, rej, drop);
+        histogram_merge(&all, &run.latency[r]);
+        rejected += rej;
+        dropped += drop;
+      }
+      print_row(placement.spec, threads[t], sizes[s], "all", &all,
+                run.elapsed_ns, rejected, dropped);
+      if (run.class_latency[PRIORITY_BACKGROUND].count != 0) {
+        print_row(placement.spec, threads[t], sizes[s], "interactive",
+                  &run.class_latency[PRIORITY_INTERACTIVE], run.elapsed_ns, 0,
+                  0);
+        print_row(placement.spec, threads[t], sizes[s], "background",
+                  &run.class_latency[PRIORITY_BACKGROUND], run.elapsed_ns, 0,
+                  0);
+      }
+      fflush(stdout);
+    }
+  }
+
+  affinity_free(&placement);
+  return 0;
+}
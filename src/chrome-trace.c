@@ -0,0 +1,138 @@
+#define _POSIX_C_SOURCE 200809L
+#include "chrome-trace.h"
+#include "clock.h"
+#include "sync.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static atomic_int enabled = 0;
+/* Bumped by ctrace_write so threads notice their buffer was freed */
+static atomic_size_t generation = 0;
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static ctrace_buf *buffers = NULL;
+static size_t next_tid = 1;
+
+static _Thread_local ctrace_buf *local = NULL;
+static _Thread_local size_t local_generation = 0;
+
+static const char *role_names[] = {"searcher", "inserter", "deleter"};
+
+static ctrace_buf *local_buf(void) {
+  size_t gen = atomic_load(&generation);
+  if (local != NULL && local_generation == gen) {
+    return local;
+  }
+
+  ctrace_buf *buf = calloc(1, sizeof(*buf));
+  buf->cap = 64;
+  buf->events = calloc(buf->cap, sizeof(*buf->events));
+
+  mutex_acquire(&buffers_lock);
+  buf->tid = next_tid++;
+  buf->next = buffers;
+  buffers = buf;
+  mutex_release(&buffers_lock);
+
+  local = buf;
+  local_generation = gen;
+  return buf;
+}
+
+static void record(const char *name, worker_role role, char phase,
+                   size_t value) {
+  if (!atomic_load_explicit(&enabled, memory_order_relaxed)) {
+    return;
+  }
+
+  ctrace_buf *buf = local_buf();
+  if (buf->len == buf->cap) {
+    buf->cap *= 2;
+    buf->events = realloc(buf->events, buf->cap * sizeof(*buf->events));
+  }
+  buf->events[buf->len++] = (ctrace_event){
+      .name = name, .role = role, .phase = phase, .value = value,
+      .ts = clock_ns()};
+}
+
+void ctrace_enable(void) { atomic_store(&enabled, 1); }
+
+int ctrace_enabled(void) { return atomic_load(&enabled); }
+
+void ctrace_begin(const char *name, worker_role role, size_t value) {
+  record(name, role, 'B', value);
+}
+
+void ctrace_end(const char *name, worker_role role, size_t value) {
+  record(name, role, 'E', value);
+}
+
+/*
+Writes every recorded event to path and frees all buffers, tracing is disabled
+afterwards. Must only be called once the traced threads are done, returns 0 on
+success and -1 if the file couldn't be written.
+*/
+int ctrace_write(const char *path) {
+  atomic_store(&enabled, 0);
+
+  mutex_acquire(&buffers_lock);
+  ctrace_buf *head = buffers;
+  buffers = NULL;
+  atomic_fetch_add(&generation, 1);
+  mutex_release(&buffers_lock);
+
+  /* Timestamps are relative to the first event so the viewer starts at 0 */
+  uint64_t start = UINT64_MAX;
+  for (ctrace_buf *buf = head; buf != NULL; buf = buf->next) {
+    if (buf->len > 0 && buf->events[0].ts < start) {
+      start = buf->events[0].ts;
+    }
+  }
+
+  FILE *f = fopen(path, "w");
+  int ret = 0;
+  if (f == NULL) {
+    perror("Couldn't open trace file");
+    ret = -1;
+  } else {
+    int first = 1;
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (ctrace_buf *buf = head; buf != NULL; buf = buf->next) {
+      if (buf->len == 0) {
+        continue;
+      }
+      /* Name the thread after the role of its first event */
+      fprintf(f,
+              "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+              "\"tid\":%zu,\"args\":{\"name\":\"%s %zu\"}}",
+              first ? "" : ",\n", buf->tid, role_names[buf->events[0].role],
+              buf->tid);
+      first = 0;
+      for (size_t i = 0; i < buf->len; i++) {
+        ctrace_event *ev = &buf->events[i];
+        uint64_t ts = ev->ts - start;
+        fprintf(f,
+                ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\","
+                "\"ts\":%llu.%03llu,\"pid\":1,\"tid\":%zu,"
+                "\"args\":{\"value\":%zu}}",
+                ev->name, role_names[ev->role], ev->phase,
+                (unsigned long long)(ts / 1000), (unsigned long long)(ts % 1000),
+                buf->tid, ev->value);
+      }
+    }
+    fprintf(f, "\n]}\n");
+    if (fclose(f) != 0) {
+      perror("Couldn't write trace file");
+      ret = -1;
+    }
+  }
+
+  while (head != NULL) {
+    ctrace_buf *next = head->next;
+    free(head->events);
+    free(head);
+    head = next;
+  }
+
+  return ret;
+}
@@ -0,0 +1,41 @@
+#ifndef _CHROME_TRACE_INCLUDE_H
+#define _CHROME_TRACE_INCLUDE_H
+
+#include "events.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Records begin/end events for each phase of the workers and writes them as
+Chrome trace-event JSON, which can be opened in chrome://tracing or Perfetto.
+
+Every thread appends to its own buffer, so recording never contends with other
+workers. Buffers are only registered (under a mutex) the first time a thread
+records something, and are all collected by ctrace_write.
+
+All functions are no-ops unless ctrace_enable was called.
+*/
+
+typedef struct {
+  const char *name;
+  worker_role role;
+  char phase;
+  size_t value;
+  uint64_t ts;
+} ctrace_event;
+
+typedef struct ctrace_buf {
+  struct ctrace_buf *next;
+  size_t tid;
+  size_t len;
+  size_t cap;
+  ctrace_event *events;
+} ctrace_buf;
+
+void ctrace_enable(void);
+int ctrace_enabled(void);
+void ctrace_begin(const char *name, worker_role role, size_t value);
+void ctrace_end(const char *name, worker_role role, size_t value);
+int ctrace_write(const char *path);
+
+#endif
@@ -0,0 +1,333 @@
+#define _GNU_SOURCE
+#include "args.h"
+#include "clock.h"
+#include "histogram.h"
+#include "protocol.h"
+#include "workload.h"
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+Load generator for mc504-server. Every connection runs in a thread of its own
+and keeps depth requests in flight: it sends depth requests at once and then
+one more for every response, so the server always has work pipelined. Roles
+and keys are drawn from a workload, with a seed of its own per connection.
+Prints the request throughput and the latency of each role, measured from the
+moment a request was sent until its response arrived.
+*/
+
+#define DEFAULT_SOCKET "/tmp/mc504.sock"
+
+static const char *role_names[] = {"Search", "Insert", "Delete"};
+
+typedef struct {
+  const char *path;
+  workload wl;
+  size_t depth;
+  /* Results, read after join */
+  histogram latency[3];
+  size_t misses;
+  size_t errors;
+  int failed;
+} connection;
+
+static int connect_to(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("Failed to connect to the server");
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  return fd;
+}
+
+static int send_all(int fd, const unsigned char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/* Draws the next request and encodes it in buf, returns 0 once the workload
+is done */
+static int next_request(workload_gen *g, uint32_t seq, unsigned char *buf) {
+  worker_role role;
+  if (!workload_next_role(g, &role)) {
+    return 0;
+  }
+  protocol_request req = {.op = (uint8_t)role,
+                          .seq = seq,
+                          .key = workload_next_key(g)};
+  protocol_encode_request(&req, buf);
+  return 1;
+}
+
+static void *run_connection(void *arg) {
+  connection *c = arg;
+  workload_gen gen;
+  size_t total = c->wl.total_ops;
+  /* Indexed by seq, which is the request's position */
+  uint64_t *sent_ns = calloc(total, sizeof(*sent_ns));
+  uint8_t *roles = calloc(total, sizeof(*roles));
+  unsigned char *out = malloc(c->depth * PROTOCOL_REQUEST_SIZE);
+  unsigned char in[PROTOCOL_RESPONSE_SIZE * 256];
+  size_t in_len = 0;
+  size_t sent = 0;
+  size_t received = 0;
+
+  int fd = connect_to(c->path);
+  if (fd < 0) {
+    c->failed = 1;
+    goto out;
+  }
+  workload_gen_init(&gen, &c->wl);
+
+  /* Fill the pipeline */
+  size_t batch = 0;
+  while (batch < c->depth &&
+         next_request(&gen, (uint32_t)sent,
+                      out + batch * PROTOCOL_REQUEST_SIZE)) {
+    roles[sent] = out[batch * PROTOCOL_REQUEST_SIZE];
+    sent_ns[sent] = clock_ns();
+    sent++;
+    batch++;
+  }
+  if (send_all(fd, out, batch * PROTOCOL_REQUEST_SIZE) < 0) {
+    c->failed = 1;
+  }
+
+  while (!c->failed && received < sent) {
+    ssize_t n = read(fd, in + in_len, sizeof(in) - in_len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      fprintf(stderr, "Connection closed by the server\n");
+      c->failed = 1;
+      break;
+    }
+    in_len += (size_t)n;
+
+    uint64_t now = clock_ns();
+    size_t pos = 0;
+    batch = 0;
+    for (; pos + PROTOCOL_RESPONSE_SIZE <= in_len;
+         pos += PROTOCOL_RESPONSE_SIZE) {
+      protocol_response res;
+      protocol_decode_response(in + pos, &res);
+      received++;
+      if (res.seq >= sent) {
+        c->errors++;
+        continue;
+      }
+      histogram_record(&c->latency[roles[res.seq]], now - sent_ns[res.seq]);
+      c->misses += res.status == PROTOCOL_MISS;
+      c->errors += res.status == PROTOCOL_BAD_REQUEST;
+
+      /* Every response makes room for another request */
+      if (next_request(&gen, (uint32_t)sent,
+                       out + batch * PROTOCOL_REQUEST_SIZE)) {
+        roles[sent] = out[batch * PROTOCOL_REQUEST_SIZE];
+        sent_ns[sent] = now;
+        sent++;
+        batch++;
+      }
+    }
+    memmove(in, in + pos, in_len - pos);
+    in_len -= pos;
+    if (batch > 0 && send_all(fd, out, batch * PROTOCOL_REQUEST_SIZE) < 0) {
+      c->failed = 1;
+    }
+  }
+  close(fd);
+
+out:
+  free(out);
+  free(roles);
+  free(sent_ns);
+  return NULL;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [options]\n", prog);
+  fprintf(stderr, "  --socket PATH       server socket (default %s)\n",
+          DEFAULT_SOCKET);
+  fprintf(stderr, "  --connections N     concurrent connections (default "
+                  "4)\n");
+  fprintf(stderr, "  --depth N           requests in flight per connection "
+                  "(default 32)\n");
+  fprintf(stderr, "  --requests N        requests per connection (default "
+                  "100000)\n");
+  fprintf(stderr, "  --mix S:I:D         percentage of searches, inserts and "
+                  "deletes (default 34:33:33)\n");
+  fprintf(stderr, "  --keys DIST         uniform, zipfian[:THETA], "
+                  "hotspot[:HOT_KEYS:HOT_OPS] or sequential\n");
+  fprintf(stderr, "  --range N           keys are drawn from [1, N] (default "
+                  "2000)\n");
+  fprintf(stderr, "  --seed N            seed of the first connection, the "
+                  "others use the next ones\n");
+  fprintf(stderr, "  -h, --help          show this message\n");
+}
+
+enum {
+  OPT_SOCKET = 256,
+  OPT_CONNECTIONS,
+  OPT_DEPTH,
+  OPT_REQUESTS,
+  OPT_MIX,
+  OPT_KEYS,
+  OPT_RANGE,
+  OPT_SEED,
+};
+
+static const struct option long_options[] = {
+    {"socket", required_argument, NULL, OPT_SOCKET},
+    {"connections", required_argument, NULL, OPT_CONNECTIONS},
+    {"depth", required_argument, NULL, OPT_DEPTH},
+    {"requests", required_argument, NULL, OPT_REQUESTS},
+    {"mix", required_argument, NULL, OPT_MIX},
+    {"keys", required_argument, NULL, OPT_KEYS},
+    {"range", required_argument, NULL, OPT_RANGE},
+    {"seed", required_argument, NULL, OPT_SEED},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0},
+};
+
+int main(int argc, char **argv) {
+  const char *path = DEFAULT_SOCKET;
+  size_t nconns = 4;
+  size_t depth = 32;
+  workload wl;
+  int opt;
+
+  workload_defaults(&wl);
+  wl.total_ops = 100000;
+  wl.key_range = 2000;
+  while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+    switch (opt) {
+    case OPT_SOCKET:
+      path = optarg;
+      break;
+    case OPT_CONNECTIONS:
+      nconns = args_parse_size(optarg, "number of connections");
+      break;
+    case OPT_DEPTH:
+      depth = args_parse_size(optarg, "depth");
+      break;
+    case OPT_REQUESTS:
+      wl.total_ops = args_parse_size(optarg, "number of requests");
+      break;
+    case OPT_MIX:
+      if (workload_parse_mix(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid operation mix: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_KEYS:
+      if (workload_parse_keys(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid key distribution: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_RANGE:
+      wl.key_range = args_parse_size(optarg, "range");
+      break;
+    case OPT_SEED:
+      wl.seed = args_parse_size(optarg, "seed");
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  const char *err = workload_validate(&wl);
+  if (err != NULL || nconns == 0 || depth == 0 || wl.total_ops == 0 ||
+      wl.total_ops > UINT32_MAX) {
+    fprintf(stderr, "Invalid workload: %s\n",
+            err != NULL ? err : "connections, depth and requests must be set");
+    return 1;
+  }
+  if (wl.seed == 0) {
+    wl.seed = rng_fresh_seed();
+  }
+
+  connection *conns = calloc(nconns, sizeof(*conns));
+  pthread_t *threads = calloc(nconns, sizeof(*threads));
+  uint64_t start = clock_ns();
+  for (size_t i = 0; i < nconns; i++) {
+    conns[i].path = path;
+    conns[i].wl = wl;
+    conns[i].wl.seed = wl.seed + i;
+    conns[i].depth = depth;
+    pthread_create(&threads[i], NULL, run_connection, &conns[i]);
+  }
+
+  histogram latency[3] = {0};
+  size_t misses = 0;
+  size_t errors = 0;
+  int failed = 0;
+  for (size_t i = 0; i < nconns; i++) {
+    pthread_join(threads[i], NULL);
+    for (int r = 0; r < 3; r++) {
+      histogram_merge(&latency[r], &conns[i].latency[r]);
+    }
+    misses += conns[i].misses;
+    errors += conns[i].errors;
+    failed |= conns[i].failed;
+  }
+  uint64_t elapsed = clock_ns() - start;
+
+  size_t done = 0;
+  for (int r = 0; r < 3; r++) {
+    done += latency[r].count;
+  }
+  printf("Requests: %zu on %zu connections, %zu in flight each\n", done,
+         nconns, depth);
+  printf("Throughput: %.1f requests/s\n",
+         (double)done * 1e9 / (double)elapsed);
+  for (int r = 0; r < 3; r++) {
+    const histogram *h = &latency[r];
+    if (h->count == 0) {
+      continue;
+    }
+    printf("%s latency: mean %.1f us, p50 %.1f us, p99 %.1f us, p999 %.1f "
+           "us, max %.1f us\n",
+           role_names[r], histogram_mean(h) / 1e3,
+           (double)histogram_percentile(h, 50) / 1e3,
+           (double)histogram_percentile(h, 99) / 1e3,
+           (double)histogram_percentile(h, 99.9) / 1e3, (double)h->max / 1e3);
+  }
+  printf("Misses: %zu, bad requests: %zu\n", misses, errors);
+  printf("Seed: %llu\n", (unsigned long long)wl.seed);
+
+  free(threads);
+  free(conns);
+  return failed;
+}
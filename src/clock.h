@@ -0,0 +1,9 @@
+#ifndef _CLOCK_INCLUDE_H
+#define _CLOCK_INCLUDE_H
+
+#include <stdint.h>
+
+/* Nanoseconds from CLOCK_MONOTONIC, only meaningful as differences */
+uint64_t clock_ns(void);
+
+#endif
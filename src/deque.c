@@ -0,0 +1,110 @@
+#include "deque.h"
+#include <stdlib.h>
+
+static deque_array *array_new(int64_t size) {
+  deque_array *a = malloc(sizeof(*a) + (size_t)size * sizeof(a->buf[0]));
+  a->prev = NULL;
+  a->size = size;
+  return a;
+}
+
+static void *array_get(deque_array *a, int64_t i) {
+  return atomic_load_explicit(&a->buf[i & (a->size - 1)],
+                              memory_order_relaxed);
+}
+
+static void array_put(deque_array *a, int64_t i, void *item) {
+  atomic_store_explicit(&a->buf[i & (a->size - 1)], item,
+                        memory_order_relaxed);
+}
+
+/* size must be a power of two */
+void deque_init(deque *q, int64_t size) {
+  atomic_init(&q->top, 0);
+  atomic_init(&q->bottom, 0);
+  atomic_init(&q->array, array_new(size));
+}
+
+void deque_destroy(deque *q) {
+  deque_array *a = atomic_load(&q->array);
+  while (a != NULL) {
+    deque_array *prev = a->prev;
+    free(a);
+    a = prev;
+  }
+}
+
+/* Doubles the buffer, copying the live items between top and bottom */
+static deque_array *grow(deque *q, deque_array *a, int64_t top,
+                         int64_t bottom) {
+  deque_array *bigger = array_new(a->size * 2);
+  for (int64_t i = top; i < bottom; i++) {
+    array_put(bigger, i, array_get(a, i));
+  }
+  bigger->prev = a;
+  atomic_store_explicit(&q->array, bigger, memory_order_release);
+  return bigger;
+}
+
+void deque_push(deque *q, void *item) {
+  int64_t b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+  int64_t t = atomic_load_explicit(&q->top, memory_order_acquire);
+  deque_array *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+
+  if (b - t > a->size - 1) {
+    a = grow(q, a, t, b);
+  }
+  array_put(a, b, item);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+}
+
+/* Pops the most recently pushed item, returns NULL if the deque is empty */
+void *deque_take(deque *q) {
+  int64_t b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+  deque_array *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+  atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t t = atomic_load_explicit(&q->top, memory_order_relaxed);
+
+  if (t > b) {
+    /* Empty */
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    return NULL;
+  }
+
+  void *item = array_get(a, b);
+  if (t == b) {
+    /* Last item, race against thieves for it */
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+      item = NULL;
+    }
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+  }
+
+  return item;
+}
+
+/* Takes the oldest item, storing it in item on DEQUE_OK */
+deque_result deque_steal(deque *q, void **item) {
+  int64_t t = atomic_load_explicit(&q->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+
+  if (t >= b) {
+    return DEQUE_EMPTY;
+  }
+
+  deque_array *a = atomic_load_explicit(&q->array, memory_order_acquire);
+  void *x = array_get(a, t);
+  if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return DEQUE_ABORT;
+  }
+
+  *item = x;
+  return DEQUE_OK;
+}
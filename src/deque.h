@@ -0,0 +1,43 @@
+#ifndef _DEQUE_INCLUDE_H
+#define _DEQUE_INCLUDE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Chase-Lev work-stealing deque of pointers, following "Correct and Efficient
+Work-Stealing for Weak Memory Models" (Lê et al., 2013).
+
+Only the owner may call deque_push and deque_take, which work on the bottom
+end, while any thread may call deque_steal, which takes from the top end. The
+buffer grows when full; old buffers are kept until deque_destroy since a thief
+may still be reading from them.
+*/
+
+typedef struct deque_array {
+  struct deque_array *prev;
+  int64_t size;
+  _Atomic(void *) buf[];
+} deque_array;
+
+typedef struct {
+  _Atomic int64_t top;
+  _Atomic int64_t bottom;
+  _Atomic(deque_array *) array;
+} deque;
+
+typedef enum {
+  DEQUE_OK,
+  DEQUE_EMPTY,
+  /* Lost a race with another thief or the owner, it's worth retrying */
+  DEQUE_ABORT,
+} deque_result;
+
+void deque_init(deque *q, int64_t size);
+void deque_destroy(deque *q);
+void deque_push(deque *q, void *item);
+void *deque_take(deque *q);
+deque_result deque_steal(deque *q, void **item);
+
+#endif
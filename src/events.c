@@ -0,0 +1,225 @@
+#define _POSIX_C_SOURCE 200809L
+#include "events.h"
+#include "sync.h"
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void render_state(event_log *log) {
+  printf("__________________________________________________\n");
+  llist_print(log->shadow);
+  printf("STATUS:\n");
+  for (size_t i = 0; i < log->searching_cap; i++) {
+    if (log->searching[i] != 0) {
+      printf("    Searching for %zu\n", log->searching[i]);
+    }
+  }
+  if (log->inserting != 0) {
+    printf("    Inserting %zu\n", log->inserting);
+  }
+  if (log->deleting != 0) {
+    printf("    Deleting %zu\n", log->deleting);
+  }
+  printf("WAITING QUEUE:\n");
+  printf("    Searchers waiting: %d\n    Inserters waiting: %d\n    Deleters "
+         "waiting: %d\n",
+         log->waiting[ROLE_SEARCHER], log->waiting[ROLE_INSERTER],
+         log->waiting[ROLE_DELETER]);
+}
+
+static void render_result(const event *ev) {
+  printf("RESULT:\n");
+  switch (ev->role) {
+  case ROLE_SEARCHER:
+    if (ev->result == 0) {
+      printf("    The value %zu is not on the list.\n", ev->value);
+    } else {
+      printf("    The value %zu was found on the list!\n", ev->value);
+    }
+    break;
+  case ROLE_INSERTER:
+    printf("    The value %zu was inserted!\n", ev->value);
+    break;
+  case ROLE_DELETER:
+    if (ev->result == 0) {
+      printf(
+          "    The value %zu was not deleted because it is not in the list!\n",
+          ev->value);
+    } else {
+      printf("    The value %zu was deleted!\n", ev->value);
+    }
+    break;
+  }
+}
+
+/* Replays a single event on the shadow state and prints it, mirroring the
+points where the workers used to call state_print */
+static void apply(event_log *log, const event *ev) {
+  switch (ev->kind) {
+  case EVENT_WAIT:
+    log->waiting[ev->role]++;
+    render_state(log);
+    break;
+  case EVENT_ENTER:
+    log->waiting[ev->role]--;
+    if (ev->role == ROLE_SEARCHER) {
+      if (ev->slot >= log->searching_cap) {
+        size_t cap = log->searching_cap ? log->searching_cap : 16;
+        while (cap <= ev->slot) {
+          cap *= 2;
+        }
+        log->searching = realloc(log->searching, cap * sizeof(size_t));
+        for (size_t i = log->searching_cap; i < cap; i++) {
+          log->searching[i] = 0;
+        }
+        log->searching_cap = cap;
+      }
+      log->searching[ev->slot] = ev->value;
+    } else if (ev->role == ROLE_INSERTER) {
+      log->inserting = ev->value;
+    } else {
+      log->deleting = ev->value;
+    }
+    render_state(log);
+    break;
+  case EVENT_RESULT:
+    if (ev->role == ROLE_INSERTER) {
+      llist_push_back(log->shadow, ev->value);
+    } else if (ev->role == ROLE_DELETER && ev->result != 0) {
+      llist_delete(log->shadow, ev->value);
+    }
+    render_state(log);
+    render_result(ev);
+    break;
+  case EVENT_LEAVE:
+    if (ev->role == ROLE_SEARCHER) {
+      log->searching[ev->slot] = 0;
+    } else if (ev->role == ROLE_INSERTER) {
+      log->inserting = 0;
+    } else {
+      log->deleting = 0;
+    }
+    break;
+  case EVENT_STOP:
+    break;
+  }
+}
+
+static void *consumer_thread(void *args) {
+  event_log *log = args;
+
+  for (;;) {
+    sem_acquire(&log->pending);
+
+    event_cell *cell = &log->cells[log->tail & log->mask];
+    /* The producer that posted may not be the one that claimed this cell, in
+    which case the owner is between claiming and publishing it */
+    while (atomic_load_explicit(&cell->seq, memory_order_acquire) !=
+           log->tail + 1) {
+      sched_yield();
+    }
+    event ev = cell->ev;
+    atomic_store_explicit(&cell->seq, log->tail + log->mask + 1,
+                          memory_order_release);
+    log->tail++;
+
+    if (ev.kind == EVENT_STOP) {
+      break;
+    }
+    apply(log, &ev);
+  }
+
+  size_t stalls = atomic_load(&log->stalls);
+  if (stalls != 0) {
+    printf("(workers waited %zu times for room in the event log)\n", stalls);
+  }
+  fflush(stdout);
+
+  return NULL;
+}
+
+event_log *event_log_new(llist *list, size_t cap) {
+  /* Round up to a power of two so positions can be masked */
+  size_t size = 2;
+  while (size < cap) {
+    size <<= 1;
+  }
+
+  event_log *log = calloc(1, sizeof(*log));
+  log->cells = calloc(size, sizeof(*log->cells));
+  log->mask = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&log->cells[i].seq, i);
+  }
+  atomic_init(&log->head, 0);
+  atomic_init(&log->stalls, 0);
+  log->tail = 0;
+  sem_new(&log->pending, 0);
+
+  /* Nobody is operating on the list yet, so it can be copied without locks.
+  The shadow is laid out the same way so it prints the same */
+  llist_opts opts = {.sorted = list->sorted, .counted = list->counted};
+  log->shadow = llist_new_with(&opts);
+  for (lnode *cur = list->head; cur != NULL; cur = cur->next) {
+    for (size_t i = 0; i < lnode_count(list, cur); i++) {
+      llist_push_back(log->shadow, cur->value);
+    }
+  }
+  log->searching = NULL;
+  log->searching_cap = 0;
+
+  pthread_create(&log->consumer, NULL, consumer_thread, log);
+
+  return log;
+}
+
+/* Waits for the consumer to render every pending event before freeing */
+void event_log_free(event_log *log) {
+  event stop = {.kind = EVENT_STOP};
+  event_log_push(log, &stop);
+  pthread_join(log->consumer, NULL);
+
+  llist_free(log->shadow);
+  free(log->searching);
+  sem_destroy(&log->pending);
+  free(log->cells);
+  free(log);
+}
+
+/* Appends the event, waiting for the consumer if the ring is full. The
+consumer never takes the list's locks, so it's fine to wait while holding
+them */
+void event_log_push(event_log *log, const event *ev) {
+  size_t pos = atomic_load_explicit(&log->head, memory_order_relaxed);
+  event_cell *cell;
+  int stalled = 0;
+
+  for (;;) {
+    cell = &log->cells[pos & log->mask];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&log->head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* The consumer hasn't freed this cell yet, so the ring is full */
+      if (!stalled && ev->kind != EVENT_STOP) {
+        atomic_fetch_add_explicit(&log->stalls, 1, memory_order_relaxed);
+        stalled = 1;
+      }
+      sched_yield();
+      pos = atomic_load_explicit(&log->head, memory_order_relaxed);
+    } else {
+      pos = atomic_load_explicit(&log->head, memory_order_relaxed);
+    }
+  }
+
+  cell->ev = *ev;
+  atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+  sem_release(&log->pending);
+}
@@ -0,0 +1,91 @@
+#ifndef _EVENTS_INCLUDE_H
+#define _EVENTS_INCLUDE_H
+
+#include "linked-list.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef enum {
+  ROLE_SEARCHER,
+  ROLE_INSERTER,
+  ROLE_DELETER,
+} worker_role;
+
+/* Interactive operations are latency sensitive, background ones give way to
+them both when waiting for the list and in the scheduler */
+typedef enum {
+  PRIORITY_INTERACTIVE,
+  PRIORITY_BACKGROUND,
+} op_priority;
+
+typedef enum {
+  /* The worker started waiting for its semaphores */
+  EVENT_WAIT,
+  /* The worker acquired the list and is about to operate on it */
+  EVENT_ENTER,
+  /* The worker finished its operation, result holds its outcome */
+  EVENT_RESULT,
+  /* The worker released the list */
+  EVENT_LEAVE,
+  /* Only pushed by event_log_free, tells the consumer to exit */
+  EVENT_STOP,
+} event_kind;
+
+/* Fixed-size record appended by the workers, everything the consumer needs to
+render the state must be here since it never looks at the real list */
+typedef struct {
+  event_kind kind;
+  worker_role role;
+  int result;
+  size_t value;
+  /* The searcher's slot in st.searchers, only used by searchers */
+  size_t slot;
+} event;
+
+typedef struct {
+  atomic_size_t seq;
+  event ev;
+} event_cell;
+
+/*
+Lock-free multi-producer single-consumer ring buffer of events.
+
+Workers append events with event_log_push without taking any lock, and a
+dedicated consumer thread pops them in order and renders the same
+STATUS/WAITING QUEUE/RESULT output that used to be printed while holding
+st.lock. The consumer keeps its own shadow copy of the list and of the worker
+state, which it updates by replaying the events, so printing never touches the
+real list.
+
+Every event changes the shadow state, so none of them can be lost: if the ring
+is full the worker waits for the consumer to make room, and the times it had to
+are counted in stalls.
+*/
+typedef struct event_log {
+  event_cell *cells;
+  size_t mask;
+  atomic_size_t head;
+  size_t tail;
+  atomic_size_t stalls;
+  sem_t pending;
+  pthread_t consumer;
+
+  /* Shadow state, only touched by the consumer thread */
+  llist *shadow;
+  /* Value searched by each slot, 0 if the slot is free */
+  size_t *searching;
+  size_t searching_cap;
+  size_t inserting;
+  size_t deleting;
+  int waiting[3];
+} event_log;
+
+#define EVENT_LOG_DEFAULT_CAP 4096
+
+event_log *event_log_new(llist *list, size_t cap);
+void event_log_free(event_log *log);
+void event_log_push(event_log *log, const event *ev);
+
+#endif
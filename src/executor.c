@@ -0,0 +1,199 @@
+#define _POSIX_C_SOURCE 200809L
+#include "executor.h"
+#include "admission.h"
+#include "clock.h"
+#include "sync.h"
+#include <stdlib.h>
+
+static void push(exec_queue *q, exec_op *op) {
+  op->next = NULL;
+  if (q->tail == NULL) {
+    q->head = op;
+  } else {
+    q->tail->next = op;
+  }
+  q->tail = op;
+}
+
+/* Queue where op waits while it's runnable */
+static exec_queue *ready_queue(executor *ex, const exec_op *op) {
+  return op->op.ctx.priority == PRIORITY_BACKGROUND ? &ex->ready_background
+                                                    : &ex->ready;
+}
+
+/* Queue where op waits while it's parked */
+static exec_queue *parked_queue(executor *ex, const exec_op *op) {
+  return op->op.ctx.priority == PRIORITY_BACKGROUND
+             ? &ex->parked_background[op->op.role]
+             : &ex->parked[op->op.role];
+}
+
+static exec_op *pop(exec_queue *q) {
+  exec_op *op = q->head;
+  if (op != NULL) {
+    q->head = op->next;
+    if (q->head == NULL) {
+      q->tail = NULL;
+    }
+  }
+  return op;
+}
+
+/* Steps op until it's done or parked, unless it was dropped before it
+started */
+static void run(executor *ex, exec_op *e, size_t thread) {
+  worker_role role = e->op.role;
+
+  if (e->op.state == OP_START && admission_start(e->op.ctx.ticket) < 0) {
+    e->dropped = 1;
+    e->op.state = OP_DONE;
+  }
+
+  while (e->op.state != OP_DONE) {
+    size_t gen = atomic_load(&ex->generation[role]);
+    if (llist_op_step(&e->op)) {
+      break;
+    }
+
+    mutex_acquire(&ex->lock);
+    if (atomic_load(&ex->generation[role]) == gen) {
+      push(parked_queue(ex, e), e);
+      ex->parks++;
+      mutex_release(&ex->lock);
+      return;
+    }
+    /* The list was released while we were trying, so try again */
+    mutex_release(&ex->lock);
+  }
+
+  if (ex->on_done != NULL) {
+    ex->on_done(ex->on_done_arg, e, thread);
+  }
+  free(e);
+
+  if (atomic_fetch_sub(&ex->pending, 1) == 1) {
+    sem_release(&ex->idle);
+  }
+}
+
+static void *executor_thread(void *args) {
+  exec_thread *self = args;
+  executor *ex = self->ex;
+
+  for (;;) {
+    sem_acquire(&ex->available);
+    /* Stop is only set once every operation is done */
+    if (atomic_load(&ex->stop)) {
+      break;
+    }
+
+    mutex_acquire(&ex->lock);
+    exec_op *e = pop(&ex->ready);
+    if (e == NULL) {
+      e = pop(&ex->ready_background);
+    }
+    mutex_release(&ex->lock);
+    run(ex, e, self->index);
+  }
+
+  return NULL;
+}
+
+/* Starts nthreads threads which wait for operations, pinned according to
+placement if it isn't NULL */
+void executor_init(executor *ex, size_t nthreads, const affinity *placement) {
+  ex->nthreads = nthreads;
+  ex->threads = calloc(nthreads, sizeof(*ex->threads));
+  mutex_new(&ex->lock);
+  ex->ready = (exec_queue){0};
+  ex->ready_background = (exec_queue){0};
+  for (int r = 0; r < 3; r++) {
+    ex->parked[r] = (exec_queue){0};
+    ex->parked_background[r] = (exec_queue){0};
+    atomic_init(&ex->generation[r], 0);
+  }
+  sem_new(&ex->available, 0);
+  sem_new(&ex->idle, 0);
+  atomic_init(&ex->pending, 0);
+  atomic_init(&ex->stop, 0);
+  ex->on_done = NULL;
+  ex->on_done_arg = NULL;
+  ex->submitted = 0;
+  ex->parks = 0;
+
+  for (size_t i = 0; i < nthreads; i++) {
+    exec_thread *t = &ex->threads[i];
+    t->ex = ex;
+    t->index = i;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (placement != NULL) {
+      affinity_attr(placement, i, &attr);
+    }
+    pthread_create(&t->thread, &attr, executor_thread, t);
+    pthread_attr_destroy(&attr);
+  }
+}
+
+void executor_submit(executor *ex, worker_role role, llist_ctx ctx) {
+  exec_op *e = malloc(sizeof(*e));
+  *e = (exec_op){.op = {.ctx = ctx, .role = role, .state = OP_START},
+                 .issued_ns = clock_ns()};
+
+  atomic_fetch_add(&ex->pending, 1);
+  mutex_acquire(&ex->lock);
+  push(ready_queue(ex, e), e);
+  ex->submitted++;
+  mutex_release(&ex->lock);
+  sem_release(&ex->available);
+}
+
+/* Resumes the operations parked on the list, who is a mask of WAKE_* saying
+which roles may be able to get in now */
+void executor_wake(executor *ex, unsigned who) {
+  size_t woken = 0;
+
+  mutex_acquire(&ex->lock);
+  for (int r = 0; r < 3; r++) {
+    if (!(who & (1u << r))) {
+      continue;
+    }
+    atomic_fetch_add(&ex->generation[r], 1);
+    exec_op *e;
+    while ((e = pop(&ex->parked[r])) != NULL ||
+           (e = pop(&ex->parked_background[r])) != NULL) {
+      push(ready_queue(ex, e), e);
+      woken++;
+      /* Only one writer can get in, the others stay parked */
+      if (r != ROLE_SEARCHER) {
+        break;
+      }
+    }
+  }
+  mutex_release(&ex->lock);
+
+  for (size_t i = 0; i < woken; i++) {
+    sem_release(&ex->available);
+  }
+}
+
+/* Waits for every submitted operation to finish and stops the threads */
+void executor_join(executor *ex) {
+  while (atomic_load(&ex->pending) != 0) {
+    sem_acquire(&ex->idle);
+  }
+
+  atomic_store(&ex->stop, 1);
+  for (size_t i = 0; i < ex->nthreads; i++) {
+    sem_release(&ex->available);
+  }
+  for (size_t i = 0; i < ex->nthreads; i++) {
+    pthread_join(ex->threads[i].thread, NULL);
+  }
+
+  sem_destroy(&ex->available);
+  sem_destroy(&ex->idle);
+  pthread_mutex_destroy(&ex->lock);
+  free(ex->threads);
+}
@@ -0,0 +1,88 @@
+#ifndef _EXECUTOR_INCLUDE_H
+#define _EXECUTOR_INCLUDE_H
+
+#include "affinity.h"
+#include "workers.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* An operation owned by the executor, issued_ns is when it was submitted.
+dropped is set if its admission ticket was dropped before it started, in which
+case it was never stepped */
+typedef struct exec_op {
+  struct exec_op *next;
+  llist_op op;
+  uint64_t issued_ns;
+  int dropped;
+} exec_op;
+
+typedef struct {
+  exec_op *head;
+  exec_op *tail;
+} exec_queue;
+
+struct executor;
+
+typedef struct {
+  struct executor *ex;
+  size_t index;
+  pthread_t thread;
+} exec_thread;
+
+/*
+Runs operations as coroutines (see llist_op) on a small number of threads, so
+waiting operations don't hold a thread each.
+
+Runnable operations wait in ready, and every thread steps them until they
+either finish or find the list taken. In the latter case the operation is
+parked by role until the list is released: the release functions call
+executor_wake, which moves every parked searcher and at most one inserter and
+one deleter back to ready. Waking every searcher is cheap since they all get
+in together, while only one writer at a time can.
+
+To not lose a release that happens between a failed attempt and parking, the
+wakes of each role are counted in generation, and an operation is only parked
+if no wake for its role happened since it started its attempt.
+
+Runnable background operations (see op_priority) wait in ready_background
+instead, which threads only take from when ready is empty. Likewise, parked
+background operations wait in parked_background, and a wake only resumes a
+background writer if no interactive one of its role is parked. Otherwise the
+background writer it resumed could give way to an interactive one which is
+still parked, and with the list free nothing would ever wake either of them.
+
+Everything but the atomics is protected by lock. Like the worker pool,
+available counts the operations in ready so idle threads sleep on it, and idle
+is posted once every submitted operation is done.
+*/
+typedef struct executor {
+  size_t nthreads;
+  exec_thread *threads;
+  pthread_mutex_t lock;
+  exec_queue ready;
+  exec_queue ready_background;
+  exec_queue parked[3];
+  exec_queue parked_background[3];
+  atomic_size_t generation[3];
+  sem_t available;
+  atomic_size_t pending;
+  sem_t idle;
+  atomic_int stop;
+  /* Called by the executor thread after each operation, if set, with the index
+  of the thread */
+  void (*on_done)(void *arg, const exec_op *op, size_t thread);
+  void *on_done_arg;
+  size_t submitted;
+  /* Times an operation was parked, read after join */
+  size_t parks;
+} executor;
+
+void executor_init(executor *ex, size_t nthreads, const affinity *placement);
+void executor_submit(executor *ex, worker_role role, llist_ctx ctx);
+void executor_wake(executor *ex, unsigned who);
+void executor_join(executor *ex);
+
+#endif
@@ -0,0 +1,68 @@
+#include "histogram.h"
+
+static size_t bucket_of(uint64_t value) {
+  if (value < HISTOGRAM_SUB) {
+    return (size_t)value;
+  }
+  unsigned msb = 63u - (unsigned)__builtin_clzll(value);
+  unsigned shift = msb - HISTOGRAM_SUB_BITS;
+  return ((size_t)(shift + 1) << HISTOGRAM_SUB_BITS) +
+         (size_t)((value >> shift) - HISTOGRAM_SUB);
+}
+
+/* Largest value that falls in the given bucket */
+static uint64_t bucket_high(size_t bucket) {
+  if (bucket < HISTOGRAM_SUB) {
+    return bucket;
+  }
+  unsigned shift = (unsigned)(bucket >> HISTOGRAM_SUB_BITS) - 1;
+  uint64_t low = (uint64_t)(HISTOGRAM_SUB + (bucket & (HISTOGRAM_SUB - 1)))
+                 << shift;
+  return low + ((uint64_t)1 << shift) - 1;
+}
+
+void histogram_record(histogram *h, uint64_t value) {
+  h->counts[bucket_of(value)]++;
+  h->count++;
+  h->sum += value;
+  if (value > h->max) {
+    h->max = value;
+  }
+}
+
+void histogram_merge(histogram *into, const histogram *from) {
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    into->counts[i] += from->counts[i];
+  }
+  into->count += from->count;
+  into->sum += from->sum;
+  if (from->max > into->max) {
+    into->max = from->max;
+  }
+}
+
+/* Smallest recorded value such that pct percent of the values are at most it,
+rounded up to the end of its bucket. Returns 0 if the histogram is empty */
+uint64_t histogram_percentile(const histogram *h, double pct) {
+  if (h->count == 0) {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)(pct / 100.0 * (double)h->count + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      uint64_t high = bucket_high(i);
+      return high < h->max ? high : h->max;
+    }
+  }
+  return h->max;
+}
+
+double histogram_mean(const histogram *h) {
+  return h->count == 0 ? 0 : (double)h->sum / (double)h->count;
+}
@@ -0,0 +1,34 @@
+#ifndef _HISTOGRAM_INCLUDE_H
+#define _HISTOGRAM_INCLUDE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Each power of two is split in 2^HISTOGRAM_SUB_BITS buckets, so values are
+kept with a relative error of at most 1/32 */
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB (1u << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB)
+
+/*
+Log-bucketed histogram of 64-bit values, such as latencies in nanoseconds.
+
+Values below HISTOGRAM_SUB have a bucket each, and every power of two above
+that is split in HISTOGRAM_SUB buckets of equal width, so any value fits in a
+fixed number of buckets while keeping the same relative precision. It isn't
+thread-safe: every thread records to its own histogram and they are merged
+afterwards. A zeroed histogram is empty.
+*/
+typedef struct {
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+} histogram;
+
+void histogram_record(histogram *h, uint64_t value);
+void histogram_merge(histogram *into, const histogram *from);
+uint64_t histogram_percentile(const histogram *h, double pct);
+double histogram_mean(const histogram *h);
+
+#endif
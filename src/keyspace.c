@@ -0,0 +1,109 @@
+#include "keyspace.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Creates a keyspace with room for at least lists lists, each created with
+opts */
+void keyspace_init(keyspace *ks, size_t lists, const llist_opts *opts) {
+  /* Keep the table at most half full, so probes stay short */
+  size_t capacity = 2;
+  while (capacity < 2 * lists) {
+    capacity <<= 1;
+  }
+
+  ks->slots = calloc(capacity, sizeof(*ks->slots));
+  for (size_t i = 0; i < capacity; i++) {
+    atomic_init(&ks->slots[i], NULL);
+  }
+  ks->capacity = capacity;
+  atomic_init(&ks->len, 0);
+  ks->opts = *opts;
+}
+
+/* Frees every list, must only be called once nobody uses them */
+void keyspace_destroy(keyspace *ks) {
+  for (size_t i = 0; i < ks->capacity; i++) {
+    keyspace_entry *entry = atomic_load(&ks->slots[i]);
+    if (entry != NULL) {
+      llist_free(entry->list);
+      free(entry);
+    }
+  }
+  free(ks->slots);
+}
+
+/* FNV-1a */
+static uint64_t hash_name(const char *name) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) {
+    h = (h ^ *c) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/* Probes the table for name from its home slot. Returns 1 and sets id if it's
+there, 0 and sets id to the empty slot where it would go, or -1 if the table
+is full */
+static int probe(const keyspace *ks, const char *name, uint64_t h, size_t *id) {
+  for (size_t i = 0; i < ks->capacity; i++) {
+    size_t slot = (h + i) & (ks->capacity - 1);
+    keyspace_entry *entry =
+        atomic_load_explicit(&ks->slots[slot], memory_order_acquire);
+    *id = slot;
+    if (entry == NULL) {
+      return 0;
+    }
+    if (entry->hash == h && strcmp(entry->name, name) == 0) {
+      return 1;
+    }
+  }
+  return -1;
+}
+
+/* Sets id to the list called name, returns -1 if there is none */
+int keyspace_lookup(const keyspace *ks, const char *name, size_t *id) {
+  return probe(ks, name, hash_name(name), id) == 1 ? 0 : -1;
+}
+
+/* Sets id to the list called name, creating it if there is none. Returns -1
+if the name is too long or the table is full */
+int keyspace_open(keyspace *ks, const char *name, size_t *id) {
+  if (strlen(name) >= KEYSPACE_NAME_MAX) {
+    return -1;
+  }
+  uint64_t h = hash_name(name);
+  keyspace_entry *created = NULL;
+
+  for (;;) {
+    int found = probe(ks, name, h, id);
+    if (found != 0) {
+      /* Somebody else created it first */
+      if (created != NULL) {
+        llist_free(created->list);
+        free(created);
+      }
+      return found == 1 ? 0 : -1;
+    }
+
+    if (created == NULL) {
+      created = malloc(sizeof(*created));
+      strcpy(created->name, name);
+      created->hash = h;
+      created->list = llist_new_with(&ks->opts);
+    }
+    keyspace_entry *expected = NULL;
+    if (atomic_compare_exchange_strong_explicit(
+            &ks->slots[*id], &expected, created, memory_order_acq_rel,
+            memory_order_acquire)) {
+      atomic_fetch_add(&ks->len, 1);
+      return 0;
+    }
+    /* The slot was taken meanwhile, maybe by the same name, so probe again */
+  }
+}
+
+/* Returns the list with the given id, which must come from keyspace_open or
+keyspace_lookup */
+llist *keyspace_list(const keyspace *ks, size_t id) {
+  return atomic_load_explicit(&ks->slots[id], memory_order_acquire)->list;
+}
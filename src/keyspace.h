@@ -0,0 +1,49 @@
+#ifndef _KEYSPACE_INCLUDE_H
+#define _KEYSPACE_INCLUDE_H
+
+#include "linked-list.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Longest list name, including the terminator */
+#define KEYSPACE_NAME_MAX 32
+
+typedef struct {
+  char name[KEYSPACE_NAME_MAX];
+  uint64_t hash;
+  llist *list;
+} keyspace_entry;
+
+/*
+Registry of named lists. Every list keeps its own semaphores, so operations on
+different lists never wait for each other, and the registry itself takes no
+lock at all.
+
+Lists live in an open-addressing hash table with a fixed number of slots.
+Entries are only ever added, by a compare-and-swap into an empty slot, and
+never move or go away until the keyspace is destroyed, so lookups just probe
+the table. Two threads opening the same new name race for the slot and the
+loser frees its list and uses the winner's. A list's id is the index of its
+slot, which operations use to find their list without hashing the name again
+(see llist_ctx).
+
+The table can't grow, since that would move entries under concurrent lookups,
+so it must be created large enough for every list.
+*/
+typedef struct keyspace {
+  _Atomic(keyspace_entry *) *slots;
+  /* Always a power of two */
+  size_t capacity;
+  atomic_size_t len;
+  /* Options of every list created by keyspace_open */
+  llist_opts opts;
+} keyspace;
+
+void keyspace_init(keyspace *ks, size_t lists, const llist_opts *opts);
+void keyspace_destroy(keyspace *ks);
+int keyspace_open(keyspace *ks, const char *name, size_t *id);
+int keyspace_lookup(const keyspace *ks, const char *name, size_t *id);
+llist *keyspace_list(const keyspace *ks, size_t id);
+
+#endif
@@ -1,22 +1,54 @@
 #include "linked-list.h"
 #include "sync.h"
-#include "int-list.h"
+#include "slots.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 llist *llist_new(void) {
+  llist_opts opts = {0};
+  return llist_new_with(&opts);
+}
+
+llist *llist_new_with(const llist_opts *opts) {
   llist *list = calloc(1, sizeof(*list));
+  list->payload_size =
+      opts->counted || opts->dense_range ? 0 : opts->payload_size;
+  list->sorted = opts->sorted;
+  list->counted = opts->counted;
+  list->dense_range = opts->dense_range;
+  list->min_key = SIZE_MAX;
+  list->max_key = 0;
+  list->bounds_stale = 0;
+  list->dense = 0;
+  list->dense_counts = NULL;
+  list->dense_nodes = NULL;
+  list->organize = opts->sorted ? LLIST_ORGANIZE_NONE : opts->organize;
+  for (size_t i = 0; i < LLIST_HINTS; i++) {
+    atomic_init(&list->hints[i], 0);
+  }
+  atomic_init(&list->hints_head, 0);
+  list->hints_tail = 0;
   mutex_new(&list->searcher_mutex);
   mutex_new(&list->st.lock);
   sem_new(&list->no_searcher, 1);
   sem_new(&list->no_inserter, 1);
   list->head = NULL;
-  int_list_init(&list->st.searchers);
+  list->nodes = 0;
+  slots_init(&list->st.searchers);
   list->st.searchers_waiting = 0;
   list->st.inserters = 0;
   list->st.inserters_waiting = 0;
   list->st.deleters = 0;
   list->st.deleters_waiting = 0;
+  for (int i = 0; i < 3; i++) {
+    atomic_init(&list->st.interactive_waiting[i], 0);
+  }
+  cond_new(&list->st.interactive_left);
+  list->st.log = NULL;
+  list->st.metrics = NULL;
+  list->st.executor = NULL;
+  list->st.batch = NULL;
   return list;
 }
 
@@ -30,18 +62,55 @@ void llist_free(llist *list) {
     prev = cur;
   }
 
+  free(list->dense_counts);
+  free(list->dense_nodes);
   pthread_mutex_destroy(&list->searcher_mutex);
   pthread_mutex_destroy(&list->st.lock);
+  pthread_cond_destroy(&list->st.interactive_left);
+  slots_destroy(&list->st.searchers);
   sem_destroy(&list->no_searcher);
   sem_destroy(&list->no_inserter);
   free(list);
 }
 
+/* The count of a node of a counted list. Inserters bump it while searchers
+may be reading it, so it's atomic */
+static atomic_size_t *count_of(const lnode *node) {
+  return (atomic_size_t *)node->payload;
+}
+
+/* Whether key is counted in the dense array instead of having a node */
+static int in_dense(const llist *list, size_t key) {
+  return list->dense && key >= list->dense_lo &&
+         key - list->dense_lo < list->dense_len;
+}
+
+/* Returns how many copies of its value node stands for */
+size_t lnode_count(const llist *list, const lnode *node) {
+  /* Keys in the dense range have no other nodes */
+  if (in_dense(list, node->value)) {
+    return atomic_load(&list->dense_counts[node->value - list->dense_lo]);
+  }
+  return list->counted ? atomic_load(count_of(node)) : 1;
+}
+
 void llist_print(llist *list) {
   lnode *current = list->head;
 
+  for (size_t i = 0; list->dense && i < list->dense_len; i++) {
+    size_t count = atomic_load(&list->dense_counts[i]);
+    if (count == 1) {
+      printf("%zu -> ", list->dense_lo + i);
+    } else if (count > 1) {
+      printf("%zu (x%zu) -> ", list->dense_lo + i, count);
+    }
+  }
+
   while (current != NULL) {
       printf("%zu", current->value);
+      if (list->counted && lnode_count(list, current) > 1) {
+          printf(" (x%zu)", lnode_count(list, current));
+      }
       if (current->next != NULL) {
           printf(" -> ");
       }
@@ -54,17 +123,48 @@ void llist_push_back(llist *list, size_t value) {
   /*
   Append the value to the end of the linked list.
   */
-  lnode *new_node = lnode_new(value);
+  llist_push_back_kv(list, value, NULL);
+}
 
+/* Same as llist_push_back, copying the list's payload_size bytes of payload
+into the new node, or zeroing them if payload is NULL */
+void llist_push_back_kv(llist *list, size_t key, const void *payload) {
   lnode **cur = &list->head;
 
-  while (*cur != NULL) {
+  list->min_key = key < list->min_key ? key : list->min_key;
+  list->max_key = key > list->max_key ? key : list->max_key;
+  if (in_dense(list, key)) {
+    atomic_fetch_add(&list->dense_counts[key - list->dense_lo], 1);
+    list->len++;
+    return;
+  }
+
+  /* A sorted list keeps equal keys in insertion order */
+  while (*cur != NULL && (!list->sorted || (*cur)->value <= key)) {
+    if (list->counted && (*cur)->value == key) {
+      atomic_fetch_add(count_of(*cur), 1);
+      list->len++;
+      return;
+    }
     // *cur = head
     cur = &(*cur)->next;
   }
 
-  // *cur = head->next
+  size_t extra = list->counted ? sizeof(atomic_size_t) : list->payload_size;
+  lnode *new_node = calloc(1, sizeof(*new_node) + extra);
+  new_node->value = key;
+  if (list->counted) {
+    atomic_init(count_of(new_node), 1);
+  } else if (payload != NULL) {
+    memcpy(new_node->payload, payload, list->payload_size);
+  }
+
+  /* The node is complete before it's linked in, so searchers walking past
+  see either the old or the new list */
+  new_node->next = *cur;
   (*cur) = new_node;
+  list->len++;
+  list->nodes++;
 }
 
 int llist_delete(llist *list, size_t value) {
@@ -76,11 +176,34 @@ int llist_delete(llist *list, size_t value) {
   */
   lnode **cur = &list->head;
 
+  if (in_dense(list, value)) {
+    atomic_size_t *count = &list->dense_counts[value - list->dense_lo];
+    if (atomic_load(count) == 0) {
+      return 0;
+    }
+    atomic_fetch_sub(count, 1);
+    list->len--;
+    return 1;
+  }
   while ((*cur) != NULL) {
+    if (list->sorted && (*cur)->value > value) {
+      return 0;
+    }
     if ((*cur)->value == value) {
       lnode *deleted = *cur;
+      list->len--;
+      /* Deleters hold the list exclusively, nobody else changes the count */
+      if (list->counted && atomic_load(count_of(deleted)) > 1) {
+        atomic_fetch_sub(count_of(deleted), 1);
+        return 1;
+      }
       *cur = (*cur)->next;
       lnode_free(deleted);
+      list->nodes--;
+      /* The bounds may have narrowed, which llist_maintain checks */
+      if (value == list->min_key || value == list->max_key) {
+        list->bounds_stale = 1;
+      }
       return 1;
     }
     cur = &(*cur)->next;
@@ -89,6 +212,18 @@ int llist_delete(llist *list, size_t value) {
   return 0;
 }
 
+/* Records that key was found, for llist_maintain. Concurrent searchers each
+get their own entry, so this is safe while holding the list as a searcher */
+static void hint(llist *list, size_t key) {
+  if (list->organize == LLIST_ORGANIZE_NONE) {
+    return;
+  }
+  size_t i = atomic_fetch_add_explicit(&list->hints_head, 1,
+                                       memory_order_relaxed);
+  atomic_store_explicit(&list->hints[i % LLIST_HINTS], key,
+                        memory_order_relaxed);
+}
+
 lnode *llist_find(llist *list, size_t value) {
   /*
   Searches for value in the given list.
@@ -97,8 +232,18 @@ lnode *llist_find(llist *list, size_t value) {
   */
   lnode **cur = &list->head;
 
+  if (in_dense(list, value)) {
+    size_t i = value - list->dense_lo;
+    return atomic_load(&list->dense_counts[i]) > 0 ? &list->dense_nodes[i]
+                                                   : NULL;
+  }
   while ((*cur) != NULL) {
+    /* Past the key in a sorted list, so it isn't there */
+    if (list->sorted && (*cur)->value > value) {
+      return NULL;
+    }
     if ((*cur)->value == value) {
+      hint(list, value);
       return *cur;
     }
     cur = &(*cur)->next;
@@ -107,6 +252,276 @@ lnode *llist_find(llist *list, size_t value) {
   return NULL;
 }
 
+/* Moves the first node with key according to the list's policy */
+static void organize(llist *list, size_t key) {
+  /* prev points to the link to the node before cur, if there is one */
+  lnode **prev = NULL;
+  lnode **cur = &list->head;
+
+  while (*cur != NULL && (*cur)->value != key) {
+    prev = cur;
+    cur = &(*cur)->next;
+  }
+  if (*cur == NULL || cur == &list->head) {
+    return;
+  }
+
+  lnode *node = *cur;
+  if (list->organize == LLIST_ORGANIZE_MOVE_TO_FRONT) {
+    *cur = node->next;
+    node->next = list->head;
+    list->head = node;
+  } else {
+    lnode *before = *prev;
+    before->next = node->next;
+    node->next = before;
+    *prev = node;
+  }
+}
+
+/* Sets lo and hi to the smallest and largest keys in the list, returns 0 if
+it's empty */
+static int key_bounds(const llist *list, size_t *lo, size_t *hi) {
+  *lo = SIZE_MAX;
+  *hi = 0;
+  for (size_t i = 0; list->dense && i < list->dense_len; i++) {
+    if (atomic_load(&list->dense_counts[i]) > 0) {
+      size_t key = list->dense_lo + i;
+      *lo = key < *lo ? key : *lo;
+      *hi = key > *hi ? key : *hi;
+    }
+  }
+  for (const lnode *cur = list->head; cur != NULL; cur = cur->next) {
+    *lo = cur->value < *lo ? cur->value : *lo;
+    *hi = cur->value > *hi ? cur->value : *hi;
+  }
+  return *lo <= *hi;
+}
+
+/* Moves every value into a dense array over [lo, hi], which must hold all of
+them */
+static void densify(llist *list, size_t lo, size_t hi) {
+  size_t len = hi - lo + 1;
+  atomic_size_t *counts = calloc(len, sizeof(*counts));
+  lnode *nodes = calloc(len, sizeof(*nodes));
+
+  for (size_t i = 0; i < len; i++) {
+    atomic_init(&counts[i], 0);
+    nodes[i].value = lo + i;
+  }
+  /* A dense list may be narrowed, the keys it drops all have a count of 0 */
+  for (size_t i = 0; list->dense && i < list->dense_len; i++) {
+    size_t key = list->dense_lo + i;
+    if (key >= lo && key <= hi) {
+      atomic_store(&counts[key - lo], atomic_load(&list->dense_counts[i]));
+    }
+  }
+  while (list->head != NULL) {
+    lnode *node = list->head;
+    atomic_fetch_add(&counts[node->value - lo], lnode_count(list, node));
+    list->head = node->next;
+    lnode_free(node);
+  }
+
+  free(list->dense_counts);
+  free(list->dense_nodes);
+  list->dense_counts = counts;
+  list->dense_nodes = nodes;
+  list->dense_lo = lo;
+  list->dense_len = len;
+  list->dense = 1;
+  list->nodes = 0;
+}
+
+/* Turns the dense array back into nodes, where the list would have them */
+static void sparsify(llist *list) {
+  lnode *first = NULL;
+  lnode **last = &first;
+  size_t extra = list->counted ? sizeof(atomic_size_t) : 0;
+
+  for (size_t i = 0; i < list->dense_len; i++) {
+    size_t count = atomic_load(&list->dense_counts[i]);
+    /* A counted list needs a single node for all the copies */
+    size_t copies = list->counted && count > 0 ? 1 : count;
+    for (size_t j = 0; j < copies; j++) {
+      lnode *node = calloc(1, sizeof(*node) + extra);
+      node->value = list->dense_lo + i;
+      if (list->counted) {
+        atomic_init(count_of(node), count);
+      }
+      *last = node;
+      last = &node->next;
+      list->nodes++;
+    }
+  }
+
+  /* The keys left in the list are all outside the dense range, so a sorted
+  list takes the dense ones right before the first larger key */
+  lnode **at = &list->head;
+  while (list->sorted && *at != NULL && (*at)->value < list->dense_lo) {
+    at = &(*at)->next;
+  }
+  *last = *at;
+  *at = first;
+
+  list->dense = 0;
+  free(list->dense_counts);
+  free(list->dense_nodes);
+  list->dense_counts = NULL;
+  list->dense_nodes = NULL;
+}
+
+/* Switches a list with a dense_range between representations. A list becomes
+dense once every key it holds fits the range, and a dense list is resized, or
+turned back into a list if the keys no longer fit, once too many keys fell
+outside of its range. The bounds are only recomputed when they may have
+narrowed, i.e. when a node holding one of them was deleted */
+static void adapt(llist *list) {
+  size_t lo, hi;
+
+  if (list->dense_range == 0 || list->len == 0 ||
+      (list->dense && list->nodes <= LLIST_DENSE_SPILL) ||
+      (!list->dense && !list->bounds_stale &&
+       list->max_key - list->min_key >= list->dense_range)) {
+    return;
+  }
+  list->bounds_stale = 0;
+  if (!key_bounds(list, &lo, &hi)) {
+    return;
+  }
+  list->min_key = lo;
+  list->max_key = hi;
+  if (hi - lo < list->dense_range) {
+    densify(list, lo, hi);
+  } else if (list->dense) {
+    sparsify(list);
+  }
+}
+
+/*
+Applies the hints recorded by the searches since the last call, oldest first,
+and returns how many there were. Only the last LLIST_HINTS are kept, which is
+enough to move hot keys forward while bounding the work of each call. Lists
+with a dense_range also switch representation here if their keys call for it.
+This moves nodes under the searchers' feet, so it must run with the list held
+exclusively, i.e. as a deleter.
+*/
+size_t llist_maintain(llist *list) {
+  size_t head = atomic_load_explicit(&list->hints_head, memory_order_relaxed);
+  size_t tail = list->hints_tail;
+
+  if (head - tail > LLIST_HINTS) {
+    tail = head - LLIST_HINTS;
+  }
+  for (size_t i = tail; i < head; i++) {
+    organize(list, atomic_load_explicit(&list->hints[i % LLIST_HINTS],
+                                        memory_order_relaxed));
+  }
+  list->hints_tail = head;
+  adapt(list);
+
+  return head - tail;
+}
+
+/* Searches for n keys in a single traversal, setting found[i] to the first node
+containing keys[i] or to NULL if there is none. Returns how many were found */
+size_t llist_find_many(llist *list, const size_t *keys, size_t n,
+                       lnode **found) {
+  size_t left = n;
+  size_t hits = 0;
+  size_t max = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    found[i] = NULL;
+    max = keys[i] > max ? keys[i] : max;
+    /* Dense keys are answered right away, and can't be in the list */
+    if (in_dense(list, keys[i])) {
+      found[i] = llist_find(list, keys[i]);
+      hits += found[i] != NULL;
+      left--;
+    }
+  }
+  /* Batches are small, so checking every pending key against each node is
+  cheaper than anything fancier */
+  for (lnode *cur = list->head; cur != NULL && left > 0; cur = cur->next) {
+    if (list->sorted && cur->value > max) {
+      break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      if (found[i] == NULL && keys[i] == cur->value) {
+        hint(list, keys[i]);
+        found[i] = cur;
+        hits++;
+        left--;
+      }
+    }
+  }
+
+  return hits;
+}
+
+/* Calls cb with every node whose key is in [lo, hi], in list order, and returns
+how many values there were, counting every copy in a counted list. A sorted
+list is only walked up to hi. In a dense list the dense keys come first */
+size_t llist_find_range(llist *list, size_t lo, size_t hi,
+                        void (*cb)(lnode *node, void *arg), void *arg) {
+  size_t n = 0;
+
+  for (size_t i = 0; list->dense && i < list->dense_len; i++) {
+    size_t key = list->dense_lo + i;
+    size_t count = atomic_load(&list->dense_counts[i]);
+    if (key >= lo && key <= hi && count > 0) {
+      cb(&list->dense_nodes[i], arg);
+      n += count;
+    }
+  }
+  for (lnode *cur = list->head; cur != NULL; cur = cur->next) {
+    if (cur->value > hi && list->sorted) {
+      break;
+    }
+    if (cur->value >= lo && cur->value <= hi) {
+      cb(cur, arg);
+      n += lnode_count(list, cur);
+    }
+  }
+
+  return n;
+}
+
+/* Returns how many times value is in the list */
+size_t llist_count(llist *list, size_t value) {
+  if (!list->counted && !in_dense(list, value)) {
+    size_t n = 0;
+    for (lnode *cur = list->head; cur != NULL; cur = cur->next) {
+      n += cur->value == value;
+    }
+    return n;
+  }
+  lnode *node = llist_find(list, value);
+  return node != NULL ? lnode_count(list, node) : 0;
+}
+
+/* Returns the payload of the first node with key, which stays valid until the
+node is deleted, or NULL if there is none */
+void *llist_find_payload(llist *list, size_t key) {
+  lnode *node = llist_find(list, key);
+  return node != NULL ? node->payload : NULL;
+}
+
+/*
+Overwrites the payload of the first node with key in place, returns 1 if it
+was found and 0 otherwise. Unlike inserts, this changes what searchers may be
+reading, so it must run with the list held exclusively, i.e. as a deleter.
+*/
+int llist_update(llist *list, size_t key, const void *payload) {
+  void *dst = llist_find_payload(list, key);
+  if (dst == NULL) {
+    return 0;
+  }
+  memcpy(dst, payload, list->payload_size);
+  return 1;
+}
+
 lnode *lnode_new(size_t value) {
   lnode *node = calloc(1, sizeof(*node));
   node->next = NULL;
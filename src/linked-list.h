@@ -5,53 +5,171 @@
 #include <pthread.h>
 #include <stdint.h>
 #include <stdatomic.h>
-#include "int-list.h"
+#include <stddef.h>
+#include "slots.h"
 
 struct lnode;
+struct event_log;
+struct metrics;
+struct executor;
+struct search_batch;
 
+/* payload holds the list's payload_size bytes inline, allocated along with
+the node, so it's empty unless the list has payloads. In a counted list it
+holds the node's count instead */
 typedef struct lnode {
 	struct lnode* next;
 	size_t value;
+	_Alignas(max_align_t) unsigned char payload[];
 } lnode;
 
+/* Most search hints kept until the list is maintained, older ones are lost */
+#define LLIST_HINTS 16
+/* Most nodes a dense list keeps for keys outside its range before it's
+maintained into a wider range or back into a list */
+#define LLIST_DENSE_SPILL 16
+
+/*
+How a list reorganizes itself for the keys that are searched:
+
+- LLIST_ORGANIZE_NONE: Nodes stay where they were inserted
+- LLIST_ORGANIZE_MOVE_TO_FRONT: A found node moves to the head
+- LLIST_ORGANIZE_TRANSPOSE: A found node swaps places with its predecessor, so
+  only keys that stay hot make it all the way to the head
+*/
+typedef enum {
+	LLIST_ORGANIZE_NONE,
+	LLIST_ORGANIZE_MOVE_TO_FRONT,
+	LLIST_ORGANIZE_TRANSPOSE,
+} llist_organize;
+
 /*
 Only used for debugging purposes, always updated whenever a thread does any
 action.
 
-searchers is a list of integers such that each integer is a value that the thread is processing.
+searchers holds the value each active searcher is processing, every searcher owns one slot of it from acquire to release.
 inserters is an unique integer which is either the value being inserted by the thread or NULL in case no inserter is running.
 deleters is an unique integer which is either the value being deleted by the thread or NULL in case no deleters is running.
 
 The counters for deleters and inserters is just for a debugging purpose to ensure that just one is running at a time.
+
+log is where the workers append their events so they can be printed outside of
+the critical path, it's NULL when nobody is watching (e.g. in tests). The same
+goes for metrics, which are published for external monitoring.
+
+executor is the coroutine executor running the operations, if any, which is
+told whenever the list is released so it can resume the ones waiting for it.
+
+batch groups concurrent searches into shared traversals, if set.
+
+interactive_waiting counts the interactive operations of each role waiting for
+the list. Background operations don't start waiting while an interactive one
+they would delay is, and wait on interactive_left (with lock) instead.
 */
 typedef struct {
-	int_list searchers;
+	slot_registry searchers;
 	atomic_int searchers_waiting;
 	size_t inserters;
 	atomic_int inserters_waiting;
 	size_t deleters;
 	atomic_int deleters_waiting;
 	pthread_mutex_t lock;
+	atomic_int interactive_waiting[3];
+	pthread_cond_t interactive_left;
+	struct event_log *log;
+	struct metrics *metrics;
+	struct executor *executor;
+	struct search_batch *batch;
 } state;
 
 typedef struct {
 	lnode* head;
+	/* Number of values, updated by push_back and delete. Atomic so it can be
+	sampled while the run goes on */
+	atomic_size_t len;
+	/* Number of nodes, which is less than len if the list is counted */
+	size_t nodes;
 	/* The deleter holds both no_searcher and no_inserter while it's active */
 	sem_t no_searcher; 
 	/* Acts as a mutex so that only one inserter can be active at a time */
 	sem_t no_inserter;
 	pthread_mutex_t searcher_mutex;
 	atomic_int searcher_count;
+	/* Bytes of payload carried by every node, 0 for plain values */
+	size_t payload_size;
+	/* Whether nodes are kept in ascending key order */
+	int sorted;
+	/* Whether equal values share a node, see llist_opts */
+	int counted;
+	/* Largest key range kept dense, 0 if the list never is, see llist_opts.
+	min_key and max_key bound every key in the list, they're widened by
+	inserters and only narrowed by llist_maintain, which recomputes them once
+	deleters set bounds_stale by removing a node holding either of them */
+	size_t dense_range;
+	size_t min_key;
+	size_t max_key;
+	int bounds_stale;
+	/* While dense, the keys in [dense_lo, dense_lo + dense_len) have no nodes
+	in the list, they are counted in dense_counts instead, and dense_nodes
+	holds the node lookups return for each of them. Keys outside that range
+	still go to the list. All of these only change in llist_maintain */
+	int dense;
+	size_t dense_lo;
+	size_t dense_len;
+	atomic_size_t *dense_counts;
+	lnode *dense_nodes;
+	/* Searches don't move nodes themselves, they only record the keys they
+	found in hints, which llist_maintain applies later with the list held
+	exclusively. hints_head counts the recorded keys and hints_tail the applied
+	ones */
+	llist_organize organize;
+	atomic_size_t hints[LLIST_HINTS];
+	atomic_size_t hints_head;
+	size_t hints_tail;
 	state st;
 } llist;
 
+/* Options of a new list, zero for the defaults. payload_size makes it a
+key/value list, where every node carries that many bytes of payload. If sorted
+is set, inserts keep the nodes in ascending order, so searches and deletes stop
+as soon as they pass the key. organize is ignored by sorted lists, whose order
+is already fixed.
+
+If counted is set, the list is a multiset where each value has a single node
+holding how many times it was inserted: pushing a value that is already there
+only bumps its count and deleting it drops one, so duplicates cost nothing.
+Counted lists can't have payloads, since every copy would share the node's.
+
+If dense_range is set, the list switches to a dense array of counts, indexed
+by key, once every key falls in a range of at most that many keys, which makes
+lookups, inserts and deletes O(1). It switches back once enough keys fall
+outside. Lookups then return a node standing for every copy of its value, like
+in a counted list, and the list can't have payloads either */
+typedef struct {
+	size_t payload_size;
+	int sorted;
+	int counted;
+	size_t dense_range;
+	llist_organize organize;
+} llist_opts;
+
 
 llist *llist_new(void);
+llist *llist_new_with(const llist_opts *opts);
 void llist_free(llist*);
 void llist_print(llist *list);
 void llist_push_back(llist *list, size_t value);
 int llist_delete(llist *list, size_t value);
 lnode* llist_find(llist *list, size_t value);
+void llist_push_back_kv(llist *list, size_t key, const void *payload);
+void *llist_find_payload(llist *list, size_t key);
+int llist_update(llist *list, size_t key, const void *payload);
+size_t llist_find_range(llist *list, size_t lo, size_t hi,
+                        void (*cb)(lnode *node, void *arg), void *arg);
+size_t llist_find_many(llist *list, const size_t *keys, size_t n, lnode **found);
+size_t llist_maintain(llist *list);
+size_t llist_count(llist *list, size_t value);
+size_t lnode_count(const llist *list, const lnode *node);
 
 lnode *lnode_new(size_t value);
 void lnode_free(lnode *node);
@@ -1,12 +1,385 @@
+#define _GNU_SOURCE
+#include "args.h"
 #include "sched.h"
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
-#define INITIAL_SIZE 10
-#define SEARCHERS 5
-#define INSERTERS 5
-#define DELETERS 5
-#define RANDOM_UPPER_BOUND 20
+/* Each worker sleeps for 3 seconds so the state can be followed on screen */
+#define DEFAULT_WORK "sleep:3000000"
 
-int main(void) {
-  run_cfg run = run_cfg_new(INITIAL_SIZE, SEARCHERS, INSERTERS, DELETERS, RANDOM_UPPER_BOUND);
-  run_cfg_run(&run, RANDOM_UPPER_BOUND);
+static void usage(const char *prog) {
+  workload wl;
+  workload_defaults(&wl);
+
+  fprintf(stderr, "usage: %s [options]\n", prog);
+  fprintf(stderr, "Workload:\n");
+  fprintf(stderr,
+          "  --mix S:I:D         percentage of searches, inserts and deletes "
+          "(default %u:%u:%u)\n",
+          wl.search_pct, wl.insert_pct, wl.delete_pct);
+  fprintf(stderr, "  --keys DIST         uniform, zipfian[:THETA], "
+                  "hotspot[:HOT_KEYS:HOT_OPS] or sequential (default "
+                  "uniform)\n");
+  fprintf(stderr, "  --background S:I:D  percentage of searches, inserts and "
+                  "deletes issued as background operations, which give way "
+                  "to the others (default 0:0:0)\n");
+  fprintf(stderr, "  --range N           keys are drawn from [1, N] "
+                  "(default %zu)\n",
+          wl.key_range);
+  fprintf(stderr, "  --initial N         initial list size (default %zu)\n",
+          wl.initial_size);
+  fprintf(stderr, "  --lists N           spread the operations over N "
+                  "independent lists (default 1)\n");
+  fprintf(stderr, "  --payload BYTES     store BYTES of payload inline in "
+                  "every node (default none)\n");
+  fprintf(stderr, "  --sorted            keep the list sorted, so lookups stop "
+                  "at the first larger key\n");
+  fprintf(stderr, "  --counted           store duplicates as a count on a "
+                  "single node\n");
+  fprintf(stderr, "  --dense N           count keys in an array while they "
+                  "span at most N values\n");
+  fprintf(stderr, "  --organize POLICY   move found keys forward: none, "
+                  "move-to-front or transpose\n");
+  fprintf(stderr, "  --ops N             stop after N operations, 0 for no "
+                  "limit (default %zu)\n",
+          wl.total_ops);
+  fprintf(stderr, "  --duration SECS     stop after SECS seconds, not counting "
+                  "the warmup\n");
+  fprintf(stderr, "  --warmup SECS       leave the first SECS seconds out of "
+                  "the statistics (default 0)\n");
+  fprintf(stderr, "  --rate R            open loop, Poisson arrivals of R "
+                  "operations per second (default closed loop)\n");
+  fprintf(stderr, "  --outstanding N     closed loop, at most N operations in "
+                  "flight (default one per thread)\n");
+  fprintf(stderr, "  --seed N            seed for every random choice, runs "
+                  "with the same seed issue the same operations (default "
+                  "random)\n");
+  fprintf(stderr, "Replay:\n");
+  fprintf(stderr, "  --record FILE       record every operation of the run to "
+                  "FILE\n");
+  fprintf(stderr, "  --replay FILE       issue the operations recorded in FILE "
+                  "instead of the workload\n");
+  fprintf(stderr, "  --speed X           replay X times faster than recorded, 0 "
+                  "for as fast as possible (default 1)\n");
+  fprintf(stderr, "Execution:\n");
+  fprintf(stderr, "  -n, --threads N     run the operations on a pool of N "
+                  "threads (default one per operation, up to 64)\n");
+  fprintf(stderr, "  -c, --coroutines    run the operations as coroutines, "
+                  "which don't hold a thread while waiting (default one "
+                  "thread per CPU)\n");
+  fprintf(stderr, "  --affinity POLICY   pin the pool threads: none, compact, "
+                  "scatter, list:CPUS or split (default none)\n");
+  fprintf(stderr, "  -b, --batch-searches  answer concurrent searches with "
+                  "shared traversals of the list\n");
+  fprintf(stderr, "  --queue-limit N|S:I:D  most operations of each role "
+                  "issued but not done (default no limit)\n");
+  fprintf(stderr, "  --overload POLICY   what happens over the limit: reject, "
+                  "block or drop-oldest (default reject)\n");
+  fprintf(stderr, "  -s, --search-work WORK  work done by searchers "
+                  "(default %s)\n",
+          DEFAULT_WORK);
+  fprintf(stderr, "  -i, --insert-work WORK  work done by inserters "
+                  "(default %s)\n",
+          DEFAULT_WORK);
+  fprintf(stderr, "  -d, --delete-work WORK  work done by deleters "
+                  "(default %s)\n",
+          DEFAULT_WORK);
+  fprintf(stderr, "WORK is one of: none, spin:NS, sleep:US, exp:NS, "
+                  "uniform:NS\n");
+  fprintf(stderr, "Observability:\n");
+  fprintf(stderr, "  --report SECS       print throughput, list length and "
+                  "waiting counts every SECS seconds instead of the state\n");
+  fprintf(stderr, "  -t, --trace FILE    write a Chrome trace of the run to "
+                  "FILE\n");
+  fprintf(stderr, "  -m, --metrics       publish live metrics for "
+                  "mc504-stat\n");
+}
+
+enum {
+  OPT_MIX = 256,
+  OPT_KEYS,
+  OPT_BACKGROUND,
+  OPT_RANGE,
+  OPT_INITIAL,
+  OPT_LISTS,
+  OPT_PAYLOAD,
+  OPT_SORTED,
+  OPT_COUNTED,
+  OPT_DENSE,
+  OPT_ORGANIZE,
+  OPT_OPS,
+  OPT_DURATION,
+  OPT_WARMUP,
+  OPT_REPORT,
+  OPT_RATE,
+  OPT_OUTSTANDING,
+  OPT_SEED,
+  OPT_RECORD,
+  OPT_REPLAY,
+  OPT_SPEED,
+  OPT_AFFINITY,
+  OPT_QUEUE_LIMIT,
+  OPT_OVERLOAD,
+};
+
+static const struct option options[] = {
+    {"mix", required_argument, NULL, OPT_MIX},
+    {"keys", required_argument, NULL, OPT_KEYS},
+    {"background", required_argument, NULL, OPT_BACKGROUND},
+    {"range", required_argument, NULL, OPT_RANGE},
+    {"initial", required_argument, NULL, OPT_INITIAL},
+    {"lists", required_argument, NULL, OPT_LISTS},
+    {"payload", required_argument, NULL, OPT_PAYLOAD},
+    {"sorted", no_argument, NULL, OPT_SORTED},
+    {"counted", no_argument, NULL, OPT_COUNTED},
+    {"dense", required_argument, NULL, OPT_DENSE},
+    {"organize", required_argument, NULL, OPT_ORGANIZE},
+    {"ops", required_argument, NULL, OPT_OPS},
+    {"duration", required_argument, NULL, OPT_DURATION},
+    {"warmup", required_argument, NULL, OPT_WARMUP},
+    {"report", required_argument, NULL, OPT_REPORT},
+    {"rate", required_argument, NULL, OPT_RATE},
+    {"outstanding", required_argument, NULL, OPT_OUTSTANDING},
+    {"seed", required_argument, NULL, OPT_SEED},
+    {"record", required_argument, NULL, OPT_RECORD},
+    {"replay", required_argument, NULL, OPT_REPLAY},
+    {"speed", required_argument, NULL, OPT_SPEED},
+    {"affinity", required_argument, NULL, OPT_AFFINITY},
+    {"queue-limit", required_argument, NULL, OPT_QUEUE_LIMIT},
+    {"overload", required_argument, NULL, OPT_OVERLOAD},
+    {"threads", required_argument, NULL, 'n'},
+    {"coroutines", no_argument, NULL, 'c'},
+    {"batch-searches", no_argument, NULL, 'b'},
+    {"search-work", required_argument, NULL, 's'},
+    {"insert-work", required_argument, NULL, 'i'},
+    {"delete-work", required_argument, NULL, 'd'},
+    {"trace", required_argument, NULL, 't'},
+    {"metrics", no_argument, NULL, 'm'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0},
+};
+
+/* The first Ctrl-C stops issuing and lets the run drain, a second one kills
+it as usual */
+static void on_interrupt(int sig) {
+  (void)sig;
+  run_cfg_stop();
+}
+
+int main(int argc, char **argv) {
+  workload wl;
+  const char *trace_path = NULL;
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+  double speed = 1;
+  affinity placement;
+  int publish_metrics = 0;
+  size_t threads = 0;
+  double warmup = 0;
+  double report_interval = 0;
+  int coroutines = 0;
+  int batch_searches = 0;
+  size_t queue_limit[3] = {0, 0, 0};
+  overload_policy overload = OVERLOAD_REJECT;
+  work_model work[3];
+  int opt;
+
+  workload_defaults(&wl);
+  affinity_none(&placement);
+  for (int i = 0; i < 3; i++) {
+    work_parse(DEFAULT_WORK, &work[i]);
+  }
+
+  while ((opt = getopt_long(argc, argv, "t:mn:cbs:i:d:h", options, NULL)) !=
+         -1) {
+    switch (opt) {
+    case OPT_MIX:
+      if (workload_parse_mix(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid mix: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_KEYS:
+      if (workload_parse_keys(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid key distribution: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_BACKGROUND:
+      if (workload_parse_background(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid background mix: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_RANGE:
+      wl.key_range = args_parse_size(optarg, "range");
+      break;
+    case OPT_LISTS:
+      wl.lists = args_parse_size(optarg, "number of lists");
+      break;
+    case OPT_INITIAL:
+      wl.initial_size = args_parse_size(optarg, "initial size");
+      break;
+    case OPT_PAYLOAD:
+      wl.payload_size = args_parse_size(optarg, "payload size");
+      break;
+    case OPT_SORTED:
+      wl.sorted = 1;
+      break;
+    case OPT_COUNTED:
+      wl.counted = 1;
+      break;
+    case OPT_DENSE:
+      wl.dense_range = args_parse_size(optarg, "dense range");
+      break;
+    case OPT_ORGANIZE:
+      if (workload_parse_organize(optarg, &wl) < 0) {
+        fprintf(stderr, "Invalid organize policy: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_OPS:
+      wl.total_ops = args_parse_size(optarg, "number of operations");
+      break;
+    case OPT_DURATION:
+      wl.duration = args_parse_double(optarg, "duration");
+      break;
+    case OPT_WARMUP:
+      warmup = args_parse_double(optarg, "warmup");
+      break;
+    case OPT_REPORT:
+      report_interval = args_parse_double(optarg, "report interval");
+      break;
+    case OPT_RATE:
+      wl.rate = args_parse_double(optarg, "rate");
+      wl.arrival = ARRIVAL_OPEN;
+      break;
+    case OPT_OUTSTANDING:
+      wl.outstanding = args_parse_size(optarg, "number of outstanding operations");
+      break;
+    case OPT_SEED:
+      wl.seed = args_parse_size(optarg, "seed");
+      break;
+    case OPT_RECORD:
+      record_path = optarg;
+      break;
+    case OPT_REPLAY:
+      replay_path = optarg;
+      break;
+    case OPT_SPEED:
+      speed = args_parse_double(optarg, "replay speed");
+      break;
+    case OPT_AFFINITY:
+      affinity_free(&placement);
+      if (affinity_parse(optarg, &placement) < 0) {
+        fprintf(stderr, "Invalid affinity policy: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_QUEUE_LIMIT:
+      if (admission_parse_limits(optarg, queue_limit) < 0) {
+        fprintf(stderr, "Invalid queue limit: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_OVERLOAD:
+      if (admission_parse_policy(optarg, &overload) < 0) {
+        fprintf(stderr, "Invalid overload policy: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 't':
+      trace_path = optarg;
+      break;
+    case 'm':
+      publish_metrics = 1;
+      break;
+    case 'n':
+      threads = args_parse_size(optarg, "number of threads");
+      break;
+    case 'c':
+      coroutines = 1;
+      break;
+    case 'b':
+      batch_searches = 1;
+      break;
+    case 's':
+    case 'i':
+    case 'd': {
+      worker_role role = opt == 's'   ? ROLE_SEARCHER
+                         : opt == 'i' ? ROLE_INSERTER
+                                      : ROLE_DELETER;
+      if (work_parse(optarg, &work[role]) < 0) {
+        fprintf(stderr, "Invalid work model: %s\n", optarg);
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    }
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  const char *err = workload_validate(&wl);
+  if (err != NULL) {
+    fprintf(stderr, "Invalid workload: %s\n", err);
+    return 1;
+  }
+  if (wl.lists > 1 &&
+      (batch_searches || record_path != NULL || replay_path != NULL)) {
+    fprintf(stderr, "Batched searches, recording and replays need a single "
+                    "list\n");
+    return 1;
+  }
+
+  op_trace *replay = NULL;
+  if (replay_path != NULL) {
+    replay = op_trace_load(replay_path);
+    if (replay == NULL) {
+      return 1;
+    }
+  }
+
+  run_cfg run = replay != NULL ? run_cfg_replay_new(&wl, replay, speed)
+                               : run_cfg_new(&wl);
+  run.trace_path = trace_path;
+  run.record_path = record_path;
+  run.placement = placement;
+  run.publish_metrics = publish_metrics;
+  run.coroutines = coroutines;
+  run.warmup = warmup;
+  run.report_interval = report_interval;
+  run.batch_searches = batch_searches;
+  run.overload = overload;
+  for (int r = 0; r < 3; r++) {
+    run.queue_limit[r] = queue_limit[r];
+  }
+  if (threads != 0) {
+    run.threads = threads;
+  } else if (coroutines) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    run.threads = cpus > 0 ? (size_t)cpus : 1;
+  }
+  run.searchers.work = work[ROLE_SEARCHER];
+  run.inserters.work = work[ROLE_INSERTER];
+  run.deleters.work = work[ROLE_DELETER];
+  struct sigaction sa = {0};
+  sa.sa_handler = on_interrupt;
+  sa.sa_flags = (int)SA_RESETHAND;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  run_cfg_run(&run);
+
+  if (replay != NULL) {
+    op_trace_free(replay);
+  }
+  affinity_free(&placement);
 }
@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+#include "args.h"
+#include "metrics.h"
+#include "server.h"
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+Serves a list over a UNIX domain socket until SIGINT or SIGTERM, see server.h.
+*/
+
+#define DEFAULT_SOCKET "/tmp/mc504.sock"
+
+static server *running = NULL;
+
+static void on_signal(int sig) {
+  (void)sig;
+  server_stop(running);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [options]\n", prog);
+  fprintf(stderr, "  --socket PATH       where to listen (default %s)\n",
+          DEFAULT_SOCKET);
+  fprintf(stderr, "  -t, --threads N     worker pool threads (default 4)\n");
+  fprintf(stderr, "  --initial N         initial list size (default 1000)\n");
+  fprintf(stderr, "  --range N           initial values are drawn from [1, N] "
+                  "(default twice the list size)\n");
+  fprintf(stderr, "  --seed N            seed of the initial list\n");
+  fprintf(stderr, "  -m, --metrics       publish live metrics for "
+                  "mc504-stat\n");
+  fprintf(stderr, "  -h, --help          show this message\n");
+}
+
+enum {
+  OPT_SOCKET = 256,
+  OPT_INITIAL,
+  OPT_RANGE,
+  OPT_SEED,
+};
+
+static const struct option long_options[] = {
+    {"socket", required_argument, NULL, OPT_SOCKET},
+    {"threads", required_argument, NULL, 't'},
+    {"initial", required_argument, NULL, OPT_INITIAL},
+    {"range", required_argument, NULL, OPT_RANGE},
+    {"seed", required_argument, NULL, OPT_SEED},
+    {"metrics", no_argument, NULL, 'm'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0},
+};
+
+int main(int argc, char **argv) {
+  const char *path = DEFAULT_SOCKET;
+  size_t threads = 4;
+  size_t initial = 1000;
+  size_t range = 0;
+  uint64_t seed = 0;
+  int publish_metrics = 0;
+  int opt;
+
+  while ((opt = getopt_long(argc, argv, "t:mh", long_options, NULL)) != -1) {
+    switch (opt) {
+    case OPT_SOCKET:
+      path = optarg;
+      break;
+    case 't':
+      threads = args_parse_size(optarg, "number of threads");
+      break;
+    case OPT_INITIAL:
+      initial = args_parse_size(optarg, "initial size");
+      break;
+    case OPT_RANGE:
+      range = args_parse_size(optarg, "range");
+      break;
+    case OPT_SEED:
+      seed = args_parse_size(optarg, "seed");
+      break;
+    case 'm':
+      publish_metrics = 1;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  if (range == 0) {
+    range = initial > 0 ? 2 * initial : 1;
+  }
+  if (seed == 0) {
+    seed = rng_fresh_seed();
+  }
+  rng_set_run_seed(seed);
+
+  llist_opts opts = {0};
+  llist *list = llist_random(initial, range, seed, &opts);
+  if (publish_metrics) {
+    list->st.metrics = metrics_create(getpid());
+    if (list->st.metrics != NULL) {
+      metrics_set(&list->st.metrics->list_len,
+                  (int64_t)atomic_load(&list->len));
+      fprintf(stderr, "Publishing metrics, watch them with mc504-stat %ld\n",
+              (long)getpid());
+    }
+  }
+  server s;
+  if (server_init(&s, list, path, threads) < 0) {
+    return 1;
+  }
+
+  running = &s;
+  struct sigaction sa = {0};
+  sa.sa_handler = on_signal;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  printf("Serving a list of %zu values on %s with %zu threads, seed %llu\n",
+         initial, path, threads, (unsigned long long)seed);
+  fflush(stdout);
+  server_run(&s);
+  server_shutdown(&s);
+
+  printf("Connections: %zu, requests served: %zu, final list length: %zu\n",
+         s.accepted, atomic_load(&s.served), atomic_load(&list->len));
+  if (list->st.metrics != NULL) {
+    metrics_destroy(list->st.metrics);
+    list->st.metrics = NULL;
+  }
+  llist_free(list);
+}
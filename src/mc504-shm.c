@@ -0,0 +1,122 @@
+#define _POSIX_C_SOURCE 200809L
+#include "clock.h"
+#include "shm-list.h"
+#include "workload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Creates, works on and removes lists shared between processes. Any number of
+processes can run operations on the same list at once, e.g.
+
+  mc504-shm /demo create 10000
+  mc504-shm /demo run 100000 90:5:5 & mc504-shm /demo run 100000 0:50:50
+  mc504-shm /demo print
+  mc504-shm /demo remove
+*/
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s NAME create CAPACITY\n", prog);
+  fprintf(stderr, "       %s NAME run OPS [S:I:D [RANGE]]\n", prog);
+  fprintf(stderr, "       %s NAME print\n", prog);
+  fprintf(stderr, "       %s NAME remove\n", prog);
+}
+
+/* Runs ops operations drawn from the workload, like a run of main would */
+static int run(shm_list *l, size_t ops, int argc, char **argv) {
+  workload wl;
+  workload_defaults(&wl);
+  wl.total_ops = ops;
+  wl.key_range = 1000;
+  if (argc > 0 && workload_parse_mix(argv[0], &wl) < 0) {
+    fprintf(stderr, "Invalid operation mix: %s\n", argv[0]);
+    return 1;
+  }
+  if (argc > 1) {
+    wl.key_range = strtoull(argv[1], NULL, 10);
+  }
+  const char *err = workload_validate(&wl);
+  if (err != NULL) {
+    fprintf(stderr, "Invalid workload: %s\n", err);
+    return 1;
+  }
+  wl.seed = rng_fresh_seed();
+
+  workload_gen gen;
+  workload_gen_init(&gen, &wl);
+  size_t done[3] = {0};
+  size_t hits[3] = {0};
+  worker_role role;
+  uint64_t start = clock_ns();
+  while (workload_next_role(&gen, &role)) {
+    size_t key = workload_next_key(&gen);
+    int hit = 0;
+    switch (role) {
+    case ROLE_SEARCHER:
+      hit = shm_list_search(l, key);
+      break;
+    case ROLE_INSERTER:
+      hit = shm_list_insert(l, key) == 0;
+      break;
+    case ROLE_DELETER:
+      hit = shm_list_delete(l, key);
+      break;
+    }
+    done[role]++;
+    hits[role] += (size_t)hit;
+  }
+  double seconds = (double)(clock_ns() - start) / 1e9;
+
+  printf("Searches: %zu (%zu found), inserts: %zu (%zu full), deletes: %zu "
+         "(%zu found)\n",
+         done[ROLE_SEARCHER], hits[ROLE_SEARCHER], done[ROLE_INSERTER],
+         done[ROLE_INSERTER] - hits[ROLE_INSERTER], done[ROLE_DELETER],
+         hits[ROLE_DELETER]);
+  printf("Throughput: %.1f ops/s, list length: %zu\n",
+         (double)ops / seconds, shm_list_len(l));
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *name = argv[1];
+  const char *cmd = argv[2];
+
+  if (strcmp(cmd, "create") == 0) {
+    size_t capacity = argc > 3 ? strtoull(argv[3], NULL, 10) : 0;
+    if (argc != 4 || capacity == 0) {
+      usage(argv[0]);
+      return 1;
+    }
+    shm_list *l = shm_list_create(name, capacity);
+    if (l == NULL) {
+      return 1;
+    }
+    shm_list_detach(l);
+    return 0;
+  }
+
+  shm_list *l = shm_list_attach(name);
+  if (l == NULL) {
+    fprintf(stderr, "No shared list named %s\n", name);
+    return 1;
+  }
+  int ret = 0;
+  if (strcmp(cmd, "run") == 0 && argc >= 4 && argc <= 6) {
+    ret = run(l, strtoull(argv[3], NULL, 10), argc - 4, argv + 4);
+  } else if (strcmp(cmd, "print") == 0 && argc == 3) {
+    shm_list_print(l);
+  } else if (strcmp(cmd, "remove") == 0 && argc == 3) {
+    shm_list_destroy(l);
+    return 0;
+  } else {
+    usage(argv[0]);
+    ret = 1;
+  }
+  shm_list_detach(l);
+  return ret;
+}
@@ -0,0 +1,87 @@
+#define _POSIX_C_SOURCE 200809L
+#include "metrics.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+Attaches to the metrics segment published by a running `main -m` and prints
+the rate of operations per role once per interval, until the run exits.
+*/
+
+static const char *role_names[] = {"searchers", "inserters", "deleters"};
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s PID [interval_ms]\n", prog);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  pid_t pid = (pid_t)strtol(argv[1], NULL, 10);
+  long interval_ms = argc == 3 ? strtol(argv[2], NULL, 10) : 1000;
+  if (pid <= 0 || interval_ms <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const metrics *m = metrics_attach(pid);
+  if (m == NULL) {
+    fprintf(stderr, "No metrics published by process %ld\n", (long)pid);
+    return 1;
+  }
+
+  uint64_t last_completed[3];
+  uint64_t last_wait[3];
+  for (int r = 0; r < 3; r++) {
+    last_completed[r] = atomic_load_explicit(&m->completed[r],
+                                             memory_order_relaxed);
+    last_wait[r] = atomic_load_explicit(&m->lock_wait_ns[r],
+                                        memory_order_relaxed);
+  }
+
+  struct timespec interval = {.tv_sec = interval_ms / 1000,
+                              .tv_nsec = (interval_ms % 1000) * 1000000};
+  double seconds = (double)interval_ms / 1000.0;
+
+  printf("%-10s %12s %8s %8s %14s\n", "role", "ops/s", "waiting", "peak",
+         "avg wait (us)");
+  /* The segment outlives the run only if it crashed, so stop once the
+  process is gone */
+  while (kill(pid, 0) == 0 || errno == EPERM) {
+    nanosleep(&interval, NULL);
+
+    for (int r = 0; r < 3; r++) {
+      uint64_t done = atomic_load_explicit(&m->completed[r],
+                                           memory_order_relaxed);
+      uint64_t wait = atomic_load_explicit(&m->lock_wait_ns[r],
+                                           memory_order_relaxed);
+      uint64_t ops = done - last_completed[r];
+      double avg_wait =
+          ops == 0 ? 0.0 : (double)(wait - last_wait[r]) / (double)ops / 1e3;
+
+      printf("%-10s %12.1f %8ld %8ld %14.2f\n", role_names[r],
+             (double)ops / seconds,
+             (long)atomic_load_explicit(&m->waiting[r], memory_order_relaxed),
+             (long)atomic_load_explicit(&m->peak_waiting[r],
+                                        memory_order_relaxed),
+             avg_wait);
+
+      last_completed[r] = done;
+      last_wait[r] = wait;
+    }
+    printf("searchers active: %ld, list length: %ld\n\n",
+           (long)atomic_load_explicit(&m->searchers_active,
+                                      memory_order_relaxed),
+           (long)atomic_load_explicit(&m->list_len, memory_order_relaxed));
+    fflush(stdout);
+  }
+
+  metrics_detach(m);
+  return 0;
+}
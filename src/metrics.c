@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include "metrics.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+void metrics_name(pid_t pid, char *name, size_t size) {
+  snprintf(name, size, "/mc504-%ld", (long)pid);
+}
+
+/* Creates the segment for the given process, returns NULL on failure */
+metrics *metrics_create(pid_t pid) {
+  char name[METRICS_NAME_MAX];
+  metrics_name(pid, name, sizeof(name));
+
+  int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("Couldn't create metrics segment");
+    return NULL;
+  }
+  if (ftruncate(fd, sizeof(metrics)) < 0) {
+    perror("Couldn't size metrics segment");
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  metrics *m =
+      mmap(NULL, sizeof(metrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) {
+    perror("Couldn't map metrics segment");
+    shm_unlink(name);
+    return NULL;
+  }
+
+  /* ftruncate zero-fills the segment, so only the header needs to be set. The
+  magic is written last so readers never see a half initialized segment */
+  m->pid = pid;
+  atomic_thread_fence(memory_order_release);
+  m->magic = METRICS_MAGIC;
+
+  return m;
+}
+
+void metrics_destroy(metrics *m) {
+  char name[METRICS_NAME_MAX];
+  metrics_name((pid_t)m->pid, name, sizeof(name));
+  munmap(m, sizeof(metrics));
+  shm_unlink(name);
+}
+
+/* Maps the segment of the given process read-only, returns NULL if there is
+none */
+const metrics *metrics_attach(pid_t pid) {
+  char name[METRICS_NAME_MAX];
+  metrics_name(pid, name, sizeof(name));
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  const metrics *m = mmap(NULL, sizeof(metrics), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) {
+    return NULL;
+  }
+  if (m->magic != METRICS_MAGIC) {
+    munmap((void *)m, sizeof(metrics));
+    return NULL;
+  }
+
+  return m;
+}
+
+void metrics_detach(const metrics *m) { munmap((void *)m, sizeof(metrics)); }
+
+/* Updates the waiting count of role, keeping track of its peak */
+void metrics_waiting(metrics *m, worker_role role, int64_t delta) {
+  int64_t now = atomic_fetch_add_explicit(&m->waiting[role], delta,
+                                          memory_order_relaxed) +
+                delta;
+  int64_t peak = atomic_load_explicit(&m->peak_waiting[role],
+                                      memory_order_relaxed);
+  while (now > peak && !atomic_compare_exchange_weak_explicit(
+                           &m->peak_waiting[role], &peak, now,
+                           memory_order_relaxed, memory_order_relaxed)) {
+  }
+}
+
+void metrics_completed(metrics *m, worker_role role) {
+  atomic_fetch_add_explicit(&m->completed[role], 1, memory_order_relaxed);
+}
+
+void metrics_lock_wait(metrics *m, worker_role role, uint64_t ns) {
+  atomic_fetch_add_explicit(&m->lock_wait_ns[role], ns, memory_order_relaxed);
+}
+
+void metrics_set(_Atomic int64_t *field, int64_t value) {
+  atomic_store_explicit(field, value, memory_order_relaxed);
+}
+
+void metrics_add(_Atomic int64_t *field, int64_t delta) {
+  atomic_fetch_add_explicit(field, delta, memory_order_relaxed);
+}
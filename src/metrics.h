@@ -0,0 +1,45 @@
+#ifndef _METRICS_INCLUDE_H
+#define _METRICS_INCLUDE_H
+
+#include "events.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define METRICS_MAGIC 0x3154534d34303543ull /* "C504MST1" */
+#define METRICS_NAME_MAX 64
+
+/*
+Live counters of a run, published in a POSIX shared-memory segment named
+/mc504-<pid> so that mc504-stat can watch a run from another process.
+
+Every field is only ever updated with relaxed atomics, readers may see
+slightly inconsistent snapshots, which is fine for monitoring. The arrays are
+indexed by worker_role.
+*/
+typedef struct metrics {
+  uint64_t magic;
+  int64_t pid;
+  _Atomic uint64_t completed[3];
+  _Atomic int64_t waiting[3];
+  _Atomic int64_t peak_waiting[3];
+  /* Total time spent blocked on the list's semaphores */
+  _Atomic uint64_t lock_wait_ns[3];
+  /* Totals over every list of the run, kept up to date with metrics_add */
+  _Atomic int64_t searchers_active;
+  _Atomic int64_t list_len;
+} metrics;
+
+metrics *metrics_create(pid_t pid);
+void metrics_destroy(metrics *m);
+const metrics *metrics_attach(pid_t pid);
+void metrics_detach(const metrics *m);
+void metrics_name(pid_t pid, char *name, size_t size);
+
+void metrics_waiting(metrics *m, worker_role role, int64_t delta);
+void metrics_completed(metrics *m, worker_role role);
+void metrics_lock_wait(metrics *m, worker_role role, uint64_t ns);
+void metrics_set(_Atomic int64_t *field, int64_t value);
+void metrics_add(_Atomic int64_t *field, int64_t delta);
+
+#endif
@@ -0,0 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+#include "op-trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t padding;
+  uint64_t initial_len;
+  uint64_t len;
+} op_trace_header;
+
+/* Snapshots the initial list, which must not be modified concurrently, and
+allocates one buffer per pool thread */
+op_trace *op_trace_new(const llist *initial, size_t nthreads,
+                       uint64_t start_ns) {
+  op_trace *tr = calloc(1, sizeof(*tr));
+  tr->start_ns = start_ns;
+  tr->initial = calloc(initial->len + 1, sizeof(*tr->initial));
+  for (lnode *cur = initial->head; cur != NULL; cur = cur->next) {
+    for (size_t i = 0; i < lnode_count(initial, cur); i++) {
+      tr->initial[tr->initial_len++] = cur->value;
+    }
+  }
+  tr->threads = calloc(nthreads, sizeof(*tr->threads));
+  tr->nthreads = nthreads;
+
+  return tr;
+}
+
+/* Must only be called by the given pool thread */
+void op_trace_record(op_trace *tr, size_t thread, worker_role role,
+                     size_t value, uint64_t issued_ns) {
+  op_trace_buf *buf = &tr->threads[thread];
+  if (buf->len == buf->cap) {
+    buf->cap = buf->cap ? buf->cap * 2 : 64;
+    buf->ops = realloc(buf->ops, buf->cap * sizeof(*buf->ops));
+  }
+  buf->ops[buf->len++] = (op_record){
+      .role = (uint32_t)role,
+      .thread = (uint32_t)thread,
+      .value = value,
+      .issue_ns = issued_ns > tr->start_ns ? issued_ns - tr->start_ns : 0};
+}
+
+static int by_issue_time(const void *a, const void *b) {
+  const op_record *x = a;
+  const op_record *y = b;
+  return (x->issue_ns > y->issue_ns) - (x->issue_ns < y->issue_ns);
+}
+
+/* Merges the per-thread buffers into ops, sorted by issue time */
+static void merge(op_trace *tr) {
+  size_t len = tr->len;
+  for (size_t i = 0; i < tr->nthreads; i++) {
+    len += tr->threads[i].len;
+  }
+  tr->ops = realloc(tr->ops, (len + 1) * sizeof(*tr->ops));
+  for (size_t i = 0; i < tr->nthreads; i++) {
+    op_trace_buf *buf = &tr->threads[i];
+    memcpy(tr->ops + tr->len, buf->ops, buf->len * sizeof(*buf->ops));
+    tr->len += buf->len;
+    free(buf->ops);
+    *buf = (op_trace_buf){0};
+  }
+  qsort(tr->ops, tr->len, sizeof(*tr->ops), by_issue_time);
+}
+
+/*
+Writes the trace to path, must only be called once the recording threads are
+done. Returns 0 on success and -1 if the file couldn't be written.
+*/
+int op_trace_write(op_trace *tr, const char *path) {
+  merge(tr);
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    perror("Couldn't open operation trace");
+    return -1;
+  }
+
+  op_trace_header header = {.version = OP_TRACE_VERSION,
+                            .initial_len = tr->initial_len,
+                            .len = tr->len};
+  memcpy(header.magic, OP_TRACE_MAGIC, sizeof(header.magic));
+
+  int ret = 0;
+  if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+      fwrite(tr->initial, sizeof(*tr->initial), tr->initial_len, f) !=
+          tr->initial_len ||
+      fwrite(tr->ops, sizeof(*tr->ops), tr->len, f) != tr->len) {
+    perror("Couldn't write operation trace");
+    ret = -1;
+  }
+  if (fclose(f) != 0 && ret == 0) {
+    perror("Couldn't write operation trace");
+    ret = -1;
+  }
+
+  return ret;
+}
+
+/* Reads a trace written by op_trace_write, returns NULL if it can't be read or
+isn't a valid trace */
+op_trace *op_trace_load(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror("Couldn't open operation trace");
+    return NULL;
+  }
+
+  op_trace_header header;
+  if (fread(&header, sizeof(header), 1, f) != 1 ||
+      memcmp(header.magic, OP_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != OP_TRACE_VERSION) {
+    fprintf(stderr, "%s is not an operation trace\n", path);
+    fclose(f);
+    return NULL;
+  }
+
+  /* The lengths must account for the rest of the file exactly, which also
+  keeps a corrupted header from making us allocate more than the file holds */
+  struct stat st;
+  size_t rest = 0;
+  int sized = fstat(fileno(f), &st) == 0 &&
+              (uint64_t)st.st_size >= sizeof(header);
+  if (sized) {
+    rest = (size_t)st.st_size - sizeof(header);
+    sized = header.initial_len <= rest / sizeof(uint64_t);
+  }
+  if (sized) {
+    rest -= (size_t)header.initial_len * sizeof(uint64_t);
+    sized = rest % sizeof(op_record) == 0 &&
+            header.len == rest / sizeof(op_record);
+  }
+  if (!sized) {
+    fprintf(stderr, "%s is truncated or corrupted\n", path);
+    fclose(f);
+    return NULL;
+  }
+
+  op_trace *tr = calloc(1, sizeof(*tr));
+  tr->initial_len = (size_t)header.initial_len;
+  tr->len = (size_t)header.len;
+  tr->initial = calloc(tr->initial_len, sizeof(*tr->initial));
+  tr->ops = calloc(tr->len, sizeof(*tr->ops));
+
+  int ok = (tr->initial != NULL || tr->initial_len == 0) &&
+           (tr->ops != NULL || tr->len == 0) &&
+           fread(tr->initial, sizeof(*tr->initial), tr->initial_len, f) ==
+               tr->initial_len &&
+           fread(tr->ops, sizeof(*tr->ops), tr->len, f) == tr->len;
+  fclose(f);
+
+  for (size_t i = 0; ok && i < tr->len; i++) {
+    ok = tr->ops[i].role <= ROLE_DELETER;
+  }
+  if (!ok) {
+    fprintf(stderr, "%s is truncated or corrupted\n", path);
+    op_trace_free(tr);
+    return NULL;
+  }
+
+  return tr;
+}
+
+void op_trace_free(op_trace *tr) {
+  for (size_t i = 0; i < tr->nthreads; i++) {
+    free(tr->threads[i].ops);
+  }
+  free(tr->threads);
+  free(tr->initial);
+  free(tr->ops);
+  free(tr);
+}
@@ -0,0 +1,60 @@
+#ifndef _OP_TRACE_INCLUDE_H
+#define _OP_TRACE_INCLUDE_H
+
+#include "events.h"
+#include "linked-list.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define OP_TRACE_MAGIC "MC504OPS"
+#define OP_TRACE_VERSION 1
+
+/* A single operation of a run. issue_ns is relative to the start of the run
+and thread is the index of the pool thread which executed it */
+typedef struct {
+  uint32_t role;
+  uint32_t thread;
+  uint64_t value;
+  uint64_t issue_ns;
+} op_record;
+
+/* Operations recorded by a single pool thread */
+typedef struct {
+  op_record *ops;
+  size_t len;
+  size_t cap;
+} op_trace_buf;
+
+/*
+Recorded traffic of a run, which can be replayed against the list.
+
+While recording every pool thread appends to its own buffer, so recording never
+contends. op_trace_write merges the buffers in issue order into ops, which is
+also what op_trace_load fills.
+
+The file holds, in native byte order:
+
+- The magic "MC504OPS", a uint32 version and a uint32 of padding
+- The number of initial values and the number of operations, as uint64
+- The initial values of the list, as uint64
+- The operations, as op_record
+*/
+typedef struct {
+  uint64_t start_ns;
+  uint64_t *initial;
+  size_t initial_len;
+  op_trace_buf *threads;
+  size_t nthreads;
+  op_record *ops;
+  size_t len;
+} op_trace;
+
+op_trace *op_trace_new(const llist *initial, size_t nthreads,
+                       uint64_t start_ns);
+void op_trace_record(op_trace *tr, size_t thread, worker_role role,
+                     size_t value, uint64_t issued_ns);
+int op_trace_write(op_trace *tr, const char *path);
+op_trace *op_trace_load(const char *path);
+void op_trace_free(op_trace *tr);
+
+#endif
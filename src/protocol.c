@@ -0,0 +1,28 @@
+#include "protocol.h"
+#include <string.h>
+
+void protocol_encode_request(const protocol_request *req, unsigned char *buf) {
+  memset(buf, 0, PROTOCOL_REQUEST_SIZE);
+  buf[0] = req->op;
+  memcpy(buf + 4, &req->seq, sizeof(req->seq));
+  memcpy(buf + 8, &req->key, sizeof(req->key));
+}
+
+void protocol_decode_request(const unsigned char *buf, protocol_request *req) {
+  req->op = buf[0];
+  memcpy(&req->seq, buf + 4, sizeof(req->seq));
+  memcpy(&req->key, buf + 8, sizeof(req->key));
+}
+
+void protocol_encode_response(const protocol_response *res,
+                              unsigned char *buf) {
+  memset(buf, 0, PROTOCOL_RESPONSE_SIZE);
+  memcpy(buf, &res->seq, sizeof(res->seq));
+  buf[4] = res->status;
+}
+
+void protocol_decode_response(const unsigned char *buf,
+                              protocol_response *res) {
+  memcpy(&res->seq, buf, sizeof(res->seq));
+  res->status = buf[4];
+}
@@ -0,0 +1,66 @@
+#ifndef _PROTOCOL_INCLUDE_H
+#define _PROTOCOL_INCLUDE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Binary protocol between mc504-server and its clients, over a UNIX domain
+socket, so both ends share the byte order and everything is in host order.
+
+A request is PROTOCOL_REQUEST_SIZE bytes:
+
+- op (1 byte): one of protocol_op
+- 3 bytes of padding, ignored
+- seq (4 bytes): chosen by the client, echoed in the response
+- key (8 bytes)
+
+A response is PROTOCOL_RESPONSE_SIZE bytes:
+
+- seq (4 bytes): the seq of the request
+- status (1 byte): one of protocol_status
+- 3 bytes of padding, zeroed
+
+Requests are pipelined: a client can send as many as it wants without waiting,
+and they run concurrently like any other operations, so responses come back in
+completion order and clients match them to requests by seq.
+*/
+
+#define PROTOCOL_REQUEST_SIZE 16
+#define PROTOCOL_RESPONSE_SIZE 8
+
+/* In the same order as worker_role */
+typedef enum {
+  PROTOCOL_SEARCH,
+  PROTOCOL_INSERT,
+  PROTOCOL_DELETE,
+} protocol_op;
+
+typedef enum {
+  /* The key wasn't found, or wasn't there to delete */
+  PROTOCOL_MISS,
+  /* The key was found, inserted or deleted */
+  PROTOCOL_OK,
+  /* The request had an unknown op or key 0, which lists can't hold */
+  PROTOCOL_BAD_REQUEST,
+} protocol_status;
+
+typedef struct {
+  uint8_t op;
+  uint32_t seq;
+  uint64_t key;
+} protocol_request;
+
+typedef struct {
+  uint32_t seq;
+  uint8_t status;
+} protocol_response;
+
+void protocol_encode_request(const protocol_request *req, unsigned char *buf);
+void protocol_decode_request(const unsigned char *buf, protocol_request *req);
+void protocol_encode_response(const protocol_response *res,
+                              unsigned char *buf);
+void protocol_decode_response(const unsigned char *buf,
+                              protocol_response *res);
+
+#endif
@@ -0,0 +1,78 @@
+#define _POSIX_C_SOURCE 200809L
+#include "rng.h"
+#include "clock.h"
+#include <stdatomic.h>
+#include <unistd.h>
+
+static _Atomic uint64_t run_seed = 0;
+/* Streams handed out to threads calling rng_local, starting far from the ones
+used explicitly */
+static _Atomic uint64_t next_local_stream = 1u << 20;
+
+static _Thread_local rng local;
+static _Thread_local int local_seeded = 0;
+
+uint64_t splitmix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15u);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+  return z ^ (z >> 31);
+}
+
+void rng_seed(rng *r, uint64_t seed, uint64_t stream) {
+  uint64_t x = seed ^ splitmix64(&stream);
+  for (int i = 0; i < 4; i++) {
+    r->s[i] = splitmix64(&x);
+  }
+}
+
+static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+uint64_t rng_next(rng *r) {
+  uint64_t *s = r->s;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+/* Uniform integer in [0, n), rejecting the values that would bias it */
+uint64_t rng_below(rng *r, uint64_t n) {
+  uint64_t limit = UINT64_MAX - UINT64_MAX % n;
+  uint64_t x;
+  do {
+    x = rng_next(r);
+  } while (x >= limit);
+  return x % n;
+}
+
+/* Uniform double in [0, 1) */
+double rng_unit(rng *r) { return (double)(rng_next(r) >> 11) * 0x1.0p-53; }
+
+void rng_set_run_seed(uint64_t seed) { atomic_store(&run_seed, seed); }
+
+uint64_t rng_run_seed(void) { return atomic_load(&run_seed); }
+
+/* Seed for runs which weren't given one, different for every process */
+uint64_t rng_fresh_seed(void) {
+  uint64_t x = clock_ns() ^ ((uint64_t)getpid() << 32);
+  return splitmix64(&x);
+}
+
+/* Generator of the calling thread, seeded from the run seed the first time
+it's used */
+rng *rng_local(void) {
+  if (!local_seeded) {
+    rng_seed(&local, atomic_load(&run_seed),
+             atomic_fetch_add(&next_local_stream, 1));
+    local_seeded = 1;
+  }
+  return &local;
+}
@@ -0,0 +1,34 @@
+#ifndef _RNG_INCLUDE_H
+#define _RNG_INCLUDE_H
+
+#include <stdint.h>
+
+/*
+xoshiro256** pseudo-random generator, seeded through splitmix64.
+
+Unlike rand(), every generator has its own state, so threads never contend on
+it, and the same (seed, stream) pair always produces the same sequence. A run
+derives all its generators from a single seed, using a different stream for
+each purpose, which makes any run reproducible from the seed it prints.
+*/
+typedef struct {
+  uint64_t s[4];
+} rng;
+
+uint64_t splitmix64(uint64_t *x);
+void rng_seed(rng *r, uint64_t seed, uint64_t stream);
+uint64_t rng_next(rng *r);
+uint64_t rng_below(rng *r, uint64_t n);
+double rng_unit(rng *r);
+
+/* Streams used by a run, threads using rng_local get streams of their own */
+#define RNG_STREAM_WORKLOAD 0
+#define RNG_STREAM_INITIAL_LIST 1
+#define RNG_STREAM_POOL 2
+
+void rng_set_run_seed(uint64_t seed);
+uint64_t rng_run_seed(void);
+uint64_t rng_fresh_seed(void);
+rng *rng_local(void);
+
+#endif
@@ -1,105 +1,780 @@
+#define _GNU_SOURCE
+#include "chrome-trace.h"
+#include "clock.h"
 #include "linked-list.h"
+#include "metrics.h"
+#include "sync.h"
 #include "sched.h"
 #include "workers.h"
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
-worker_queue worker_queue_new(size_t cap, llist *list, thread_fn f) {
-  worker_queue q = {0};
-  q.cap = cap;
-  q.len = 0;
-  q.function = f;
-  // TODO really?
-  q.threads = (pthread_t *)calloc(cap, sizeof(pthread_t));
-  q.ctxs = (llist_ctx *)calloc(cap, sizeof(llist_ctx));
+/* The pool thread running on this thread, if any */
+static _Thread_local pool_worker *self = NULL;
+
+/* Set by run_cfg_stop, possibly from a signal handler */
+static volatile sig_atomic_t stopping = 0;
+
+static size_t random_victim(pool_worker *w, size_t n) {
+  return (size_t)rng_below(&w->rng, n);
+}
+
+/* Tries the thread's own deque first, then its inbox, then steals from random
+victims until it finds a task. The background deque is tried after every n + 1
+misses */
+static task *find_task(pool_worker *w) {
+  worker_pool *pool = w->pool;
+  task *t = deque_take(&w->tasks);
+  size_t misses = 0;
+  void *item;
+
+  while (t == NULL) {
+    if (misses > pool->nthreads) {
+      misses = 0;
+      if (deque_steal(&pool->background, &item) == DEQUE_OK) {
+        t = item;
+      }
+      continue;
+    }
+    if (deque_steal(&w->inbox, &item) == DEQUE_OK) {
+      t = item;
+      w->inboxed++;
+      continue;
+    }
 
-  for (size_t i = 0; i < cap; i++) {
-    q.ctxs[i].list = list;
+    pool_worker *victim = &pool->workers[random_victim(w, pool->nthreads)];
+    if (victim != w && (deque_steal(&victim->tasks, &item) == DEQUE_OK ||
+                        deque_steal(&victim->inbox, &item) == DEQUE_OK)) {
+      t = item;
+      w->steals++;
+      continue;
+    }
+    misses++;
   }
 
-  return q;
+  return t;
 }
 
-void worker_queue_append_random(worker_queue *q, size_t random_upper_bound) {
-  q->ctxs[q->len].value = (size_t)(1 + (size_t)rand() % random_upper_bound);
-  pthread_create(&q->threads[q->len], NULL, q->function, &q->ctxs[q->len]);
-  q->len++;
+static void *pool_thread(void *args) {
+  pool_worker *w = args;
+  worker_pool *pool = w->pool;
+  self = w;
+
+  for (;;) {
+    sem_acquire(&pool->available);
+    /* Stop is only set once every task is done */
+    if (atomic_load(&pool->stop)) {
+      break;
+    }
+
+    task *t = find_task(w);
+    /* A dropped operation is done without ever trying to get the list */
+    t->dropped = admission_start(t->ctx.ticket) < 0;
+    if (!t->dropped && pool->placement != NULL &&
+        pool->placement->policy == AFFINITY_SPLIT) {
+      int writer = t->function != searcher_thread;
+      if (w->group != writer &&
+          affinity_pin_group(pool->placement, writer) == 0) {
+        w->group = writer;
+      }
+    }
+    if (!t->dropped) {
+      t->result = t->function(&t->ctx);
+    }
+
+    if (pool->on_done != NULL) {
+      pool->on_done(pool->on_done_arg, t, (size_t)(w - pool->workers));
+    }
+    free(t);
+
+    if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+      sem_release(&pool->idle);
+    }
+  }
+
+  return NULL;
 }
 
-void worker_queue_free(worker_queue q) {
-  free(q.threads);
-  free(q.ctxs);
+/* Starts nthreads threads which wait for tasks */
+void worker_pool_init(worker_pool *pool, size_t nthreads) {
+  worker_pool_init_placed(pool, nthreads, NULL);
 }
 
-void worker_queue_join(worker_queue q) {
-  for (size_t i = 0; i < q.len; i++) {
-    pthread_join(q.threads[i], NULL);
+/* Same as worker_pool_init, but pins the threads according to placement, which
+must outlive the pool */
+void worker_pool_init_placed(worker_pool *pool, size_t nthreads,
+                             const affinity *placement) {
+  pool->nthreads = nthreads;
+  pool->workers = calloc(nthreads, sizeof(*pool->workers));
+  atomic_init(&pool->submitted, 0);
+  pool->steals = 0;
+  pool->inboxed = 0;
+  pool->on_done = NULL;
+  pool->on_done_arg = NULL;
+  pool->placement = placement;
+  atomic_init(&pool->next_inbox, 0);
+  deque_init(&pool->background, 64);
+  mutex_new(&pool->background_lock);
+  sem_new(&pool->available, 0);
+  sem_new(&pool->idle, 0);
+  atomic_init(&pool->pending, 0);
+  atomic_init(&pool->stop, 0);
+
+  for (size_t i = 0; i < nthreads; i++) {
+    pool_worker *w = &pool->workers[i];
+    w->pool = pool;
+    rng_seed(&w->rng, rng_run_seed(), RNG_STREAM_POOL + i);
+    w->steals = 0;
+    w->inboxed = 0;
+    w->group = -1;
+    deque_init(&w->tasks, 64);
+    deque_init(&w->inbox, 64);
+    mutex_new(&w->inbox_lock);
+  }
+  for (size_t i = 0; i < nthreads; i++) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (placement != NULL) {
+      affinity_attr(placement, i, &attr);
+    }
+    pthread_create(&pool->workers[i].thread, &attr, pool_thread,
+                   &pool->workers[i]);
+    pthread_attr_destroy(&attr);
   }
-  worker_queue_free(q);
 }
 
-llist *llist_random(size_t size, size_t random_upper_bound) {
-  llist *list = llist_new();
+void worker_pool_submit(worker_pool *pool, thread_fn f, llist_ctx ctx) {
+  task *t = malloc(sizeof(*t));
+  *t = (task){.function = f, .ctx = ctx, .issued_ns = clock_ns()};
+
+  atomic_fetch_add(&pool->pending, 1);
+  if (ctx.priority == PRIORITY_BACKGROUND) {
+    mutex_acquire(&pool->background_lock);
+    deque_push(&pool->background, t);
+    pool->submitted++;
+    mutex_release(&pool->background_lock);
+  } else if (self != NULL && self->pool == pool) {
+    deque_push(&self->tasks, t);
+  } else {
+    pool_worker *w = &pool->workers[atomic_fetch_add(&pool->next_inbox, 1) %
+                                    pool->nthreads];
+    mutex_acquire(&w->inbox_lock);
+    deque_push(&w->inbox, t);
+    pool->submitted++;
+    mutex_release(&w->inbox_lock);
+  }
+  sem_release(&pool->available);
+}
+
+/* Waits for every submitted task to finish and frees the pool, after which
+pool->steals and pool->inboxed hold the totals of every thread */
+void worker_pool_join(worker_pool *pool) {
+  while (atomic_load(&pool->pending) != 0) {
+    sem_acquire(&pool->idle);
+  }
+
+  atomic_store(&pool->stop, 1);
+  for (size_t i = 0; i < pool->nthreads; i++) {
+    sem_release(&pool->available);
+  }
+  for (size_t i = 0; i < pool->nthreads; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+    pool->steals += pool->workers[i].steals;
+    pool->inboxed += pool->workers[i].inboxed;
+    deque_destroy(&pool->workers[i].tasks);
+    deque_destroy(&pool->workers[i].inbox);
+    pthread_mutex_destroy(&pool->workers[i].inbox_lock);
+  }
+
+  deque_destroy(&pool->background);
+  pthread_mutex_destroy(&pool->background_lock);
+  sem_destroy(&pool->available);
+  sem_destroy(&pool->idle);
+  free(pool->workers);
+}
+
+worker_queue worker_queue_new(llist *list, thread_fn f) {
+  worker_queue q = {0};
+  q.len = 0;
+  q.list = list;
+  q.function = f;
+
+  return q;
+}
+
+/* Pushes size random values in [1, random_upper_bound] to list */
+static void fill_random(llist *list, size_t size, size_t random_upper_bound,
+                        uint64_t seed) {
+  rng r;
+  rng_seed(&r, seed, RNG_STREAM_INITIAL_LIST);
   for (size_t i = 0; i < size; i++) {
-    llist_push_back(list, (size_t)(1 + (size_t)rand() % random_upper_bound));
+    llist_push_back(list, (size_t)(1 + rng_below(&r, random_upper_bound)));
   }
+}
+
+llist *llist_random(size_t size, size_t random_upper_bound, uint64_t seed,
+                    const llist_opts *opts) {
+  llist *list = llist_new_with(opts);
+  fill_random(list, size, random_upper_bound, seed);
 
   return list;
 }
 
-run_cfg run_cfg_new(size_t init, size_t s, size_t i, size_t d,
-                    size_t random_upper_bound) {
-  llist *list = llist_random(init, random_upper_bound);
+/* Picks a seed if the workload has none, it's printed at the start of the run
+so it can be reused */
+static void resolve_seed(workload *wl) {
+  if (wl->seed == 0) {
+    wl->seed = rng_fresh_seed();
+  }
+  rng_set_run_seed(wl->seed);
+}
+
+static run_cfg run_cfg_with_list(const workload *wl, llist *list) {
   run_cfg cfg = {0};
-  cfg.initial_size = init;
+  cfg.wl = *wl;
   cfg.list = list;
-  cfg.searchers = worker_queue_new(s, list, searcher_thread);
-  cfg.inserters = worker_queue_new(i, list, inserter_thread);
-  cfg.deleters = worker_queue_new(d, list, deleter_thread);
+  cfg.list_ids = NULL;
+  cfg.log = NULL;
+  cfg.trace_path = NULL;
+  cfg.publish_metrics = 0;
+  cfg.threads = wl->total_ops == 0 || wl->total_ops > 64 ? 64 : wl->total_ops;
+  cfg.searchers = worker_queue_new(list, searcher_thread);
+  cfg.inserters = worker_queue_new(list, inserter_thread);
+  cfg.deleters = worker_queue_new(list, deleter_thread);
+  cfg.record_path = NULL;
+  cfg.recording = NULL;
+  cfg.replay = NULL;
+  cfg.replay_speed = 1;
+  cfg.quiet = 0;
+  cfg.coroutines = 0;
+  cfg.batch_searches = 0;
+  cfg.thread_latency = NULL;
+  cfg.thread_class_latency = NULL;
+  cfg.warmup = 0;
+  cfg.report_interval = 0;
+  cfg.overload = OVERLOAD_REJECT;
+  affinity_none(&cfg.placement);
+  return cfg;
+}
+
+run_cfg run_cfg_new(const workload *wl) {
+  workload w = *wl;
+  resolve_seed(&w);
+  llist_opts opts = {.payload_size = w.payload_size, .sorted = w.sorted,
+                     .counted = w.counted,
+                     .dense_range = w.dense_range,
+                     .organize = w.organize};
+  if (w.lists <= 1) {
+    return run_cfg_with_list(
+        &w, llist_random(w.initial_size, w.key_range, w.seed, &opts));
+  }
+
+  keyspace ks;
+  size_t *ids = calloc(w.lists, sizeof(*ids));
+  keyspace_init(&ks, w.lists, &opts);
+  for (size_t i = 0; i < w.lists; i++) {
+    char name[KEYSPACE_NAME_MAX];
+    snprintf(name, sizeof(name), "list-%zu", i);
+    keyspace_open(&ks, name, &ids[i]);
+    /* Every list gets different values */
+    fill_random(keyspace_list(&ks, ids[i]), w.initial_size, w.key_range,
+                w.seed + i);
+  }
+  run_cfg cfg = run_cfg_with_list(&w, keyspace_list(&ks, ids[0]));
+  cfg.keyspace = ks;
+  cfg.list_ids = ids;
+  return cfg;
+}
+
+/* Returns the i-th list of the run */
+static llist *run_list(const run_cfg *cfg, size_t i) {
+  if (cfg->list_ids == NULL) {
+    return cfg->list;
+  }
+  return keyspace_list(&cfg->keyspace, cfg->list_ids[i]);
+}
+
+/* Creates a run which issues the operations of tr, starting from the list it
+was recorded with. The workload only supplies the seed of the simulated work
+and the default number of threads */
+run_cfg run_cfg_replay_new(const workload *wl, op_trace *tr, double speed) {
+  workload w = *wl;
+  resolve_seed(&w);
+  w.total_ops = tr->len;
+  w.lists = 1;
+
+  llist *list = llist_new();
+  for (size_t i = 0; i < tr->initial_len; i++) {
+    llist_push_back(list, (size_t)tr->initial[i]);
+  }
+
+  run_cfg cfg = run_cfg_with_list(&w, list);
+  if (tr->len > 0 && tr->len < cfg.threads) {
+    cfg.threads = tr->len;
+  }
+  cfg.replay = tr;
+  cfg.replay_speed = speed;
   return cfg;
 }
 
-void run_cfg_run(run_cfg *cfg, size_t random_upper_bound) {
-  int choice;
-  while (cfg->searchers.len < cfg->searchers.cap ||
-         cfg->inserters.len < cfg->inserters.cap ||
-         cfg->deleters.len < cfg->deleters.cap) {
-
-#if __has_attribute(__fallthrough__)
-#define fallthrough __attribute__((__fallthrough__))
-#else
-#define fallthrough                                                            \
-  do {                                                                         \
-  } while (0) /* fallthrough */
-#endif
-
-  random_choice:
-    choice = rand() % 3;
-    switch (choice) {
-    case 0:
-      if (cfg->searchers.len < cfg->searchers.cap) {
-        worker_queue_append_random(&cfg->searchers, random_upper_bound);
+/* Issues an operation, on the pool or as a coroutine, if it's admitted */
+static void worker_queue_append(run_cfg *cfg, worker_role role, size_t list,
+                                size_t value, op_priority priority) {
+  worker_queue *queues[3] = {&cfg->searchers, &cfg->inserters,
+                             &cfg->deleters};
+  worker_queue *q = queues[role];
+  llist_ctx ctx = {0};
+  ctx.list = q->list;
+  if (cfg->list_ids != NULL) {
+    /* Looked up by the worker */
+    ctx.list = NULL;
+    ctx.keyspace = &cfg->keyspace;
+    ctx.list_id = cfg->list_ids[list];
+  }
+  ctx.value = value;
+  ctx.work = q->work;
+  ctx.priority = priority;
+  if (admission_admit(&cfg->admission, role, &ctx.ticket) < 0) {
+    /* Turned away, so it never takes one of the operations in flight */
+    if (cfg->replay == NULL && cfg->wl.arrival == ARRIVAL_CLOSED) {
+      sem_release(&cfg->outstanding);
+    }
+    return;
+  }
+  if (cfg->coroutines) {
+    executor_submit(&cfg->executor, role, ctx);
+  } else {
+    worker_pool_submit(&cfg->pool, q->function, ctx);
+  }
+  q->len++;
+}
+
+static worker_role task_role(const run_cfg *cfg, const task *t) {
+  if (t->function == cfg->searchers.function) {
+    return ROLE_SEARCHER;
+  }
+  return t->function == cfg->inserters.function ? ROLE_INSERTER
+                                                : ROLE_DELETER;
+}
+
+/* Called by the thread which ran an operation, once it's done. A dropped
+operation was already accounted for by whoever dropped it */
+static void op_done(run_cfg *cfg, worker_role role, const llist_ctx *ctx,
+                    uint64_t issued_ns, size_t thread, int dropped) {
+  if (!dropped && cfg->report_interval > 0) {
+    atomic_fetch_add_explicit(&cfg->completed[role], 1, memory_order_relaxed);
+  }
+  /* The trace starts from the initial list, so it needs every operation,
+  while the warmup only keeps the first ones out of the histograms */
+  if (!dropped && cfg->recording != NULL) {
+    op_trace_record(cfg->recording, thread, role, ctx->value, issued_ns);
+  }
+  if (!dropped && issued_ns < cfg->measure_start_ns) {
+    atomic_fetch_add_explicit(&cfg->warmup_ops, 1, memory_order_relaxed);
+  } else if (!dropped) {
+    uint64_t latency = clock_ns() - issued_ns;
+    histogram_record(&cfg->thread_latency[thread * 3 + role], latency);
+    histogram_record(&cfg->thread_class_latency[thread * 2 + ctx->priority],
+                     latency);
+  }
+
+  if (cfg->replay == NULL && cfg->wl.arrival == ARRIVAL_CLOSED) {
+    sem_release(&cfg->outstanding);
+  }
+}
+
+static void task_done(void *arg, const task *t, size_t thread) {
+  run_cfg *cfg = arg;
+  worker_role role = task_role(cfg, t);
+  if (!t->dropped) {
+    admission_done(&cfg->admission, role, t->ctx.ticket);
+  }
+  op_done(cfg, role, &t->ctx, t->issued_ns, thread, t->dropped);
+}
+
+static void exec_op_done(void *arg, const exec_op *e, size_t thread) {
+  run_cfg *cfg = arg;
+  if (!e->dropped) {
+    admission_done(&cfg->admission, e->op.role, e->op.ctx.ticket);
+  }
+  op_done(cfg, e->op.role, &e->op.ctx, e->issued_ns, thread, e->dropped);
+}
+
+static void sleep_until(uint64_t deadline) {
+  uint64_t now = clock_ns();
+  if (now >= deadline) {
+    return;
+  }
+  struct timespec ts = {.tv_sec = (time_t)((deadline - now) / 1000000000u),
+                        .tv_nsec = (long)((deadline - now) % 1000000000u)};
+  nanosleep(&ts, NULL);
+}
+
+/* Issues the operations of the replayed trace at their recorded times, scaled
+by the replay speed */
+static void issue_replay(run_cfg *cfg) {
+  uint64_t start = clock_ns();
+
+  for (size_t i = 0; i < cfg->replay->len && !stopping; i++) {
+    const op_record *op = &cfg->replay->ops[i];
+    if (cfg->replay_speed > 0) {
+      sleep_until(start +
+                  (uint64_t)((double)op->issue_ns / cfg->replay_speed));
+    }
+    worker_queue_append(cfg, (worker_role)op->role, 0, (size_t)op->value,
+                        PRIORITY_INTERACTIVE);
+  }
+}
+
+/* Issues operations as described by the workload until it's done */
+static void issue(run_cfg *cfg) {
+  const workload *wl = &cfg->wl;
+  workload_gen gen;
+  worker_role role;
+
+  workload_gen_init(&gen, wl);
+  uint64_t start = clock_ns();
+  uint64_t end = wl->duration > 0
+                     ? start + (uint64_t)((cfg->warmup + wl->duration) * 1e9)
+                     : UINT64_MAX;
+  uint64_t next = start;
+
+  while (!stopping && workload_next_role(&gen, &role)) {
+    if (wl->arrival == ARRIVAL_OPEN) {
+      /* Arrivals follow their own schedule, if we fall behind the late ones
+      are issued right away instead of being skipped */
+      next += workload_next_gap_ns(&gen);
+      if (next >= end) {
         break;
       }
-      fallthrough;
-    case 1:
-      if (cfg->inserters.len < cfg->inserters.cap) {
-        worker_queue_append_random(&cfg->inserters, random_upper_bound);
+      sleep_until(next);
+      /* The sleep is cut short by the signal that stops the run */
+      if (stopping) {
         break;
       }
-      fallthrough;
-    case 2:
-      if (cfg->deleters.len < cfg->deleters.cap) {
-        worker_queue_append_random(&cfg->deleters, random_upper_bound);
+    } else {
+      sem_acquire(&cfg->outstanding);
+      if (stopping || clock_ns() >= end) {
+        sem_release(&cfg->outstanding);
         break;
       }
-      goto random_choice;
+    }
+
+    size_t list = workload_next_list(&gen);
+    size_t key = workload_next_key(&gen);
+    worker_queue_append(cfg, role, list, key,
+                        workload_next_priority(&gen, role));
+  }
+}
+
+/* Prints the throughput of each role in the last interval, the list length and
+the waiting counts every report_interval seconds, until reporter_done is
+posted */
+static void *reporter_thread(void *args) {
+  run_cfg *cfg = args;
+  uint64_t interval = (uint64_t)(cfg->report_interval * 1e9);
+  uint64_t start = clock_ns();
+  uint64_t prev = start;
+  size_t last[3] = {0, 0, 0};
+
+  for (;;) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t nsec = (uint64_t)deadline.tv_nsec + interval;
+    deadline.tv_sec += (time_t)(nsec / 1000000000u);
+    deadline.tv_nsec = (long)(nsec % 1000000000u);
+    if (sem_timedwait(&cfg->reporter_done, &deadline) == 0) {
+      break;
+    }
+    if (errno != ETIMEDOUT && errno != EINTR) {
+      perror("Failed to wait for the next report");
+      exit(1);
+    }
+
+    uint64_t now = clock_ns();
+    double secs = (double)(now - prev) / 1e9;
+    double rate[3];
+    for (int r = 0; r < 3; r++) {
+      size_t done = atomic_load(&cfg->completed[r]);
+      rate[r] = (double)(done - last[r]) / secs;
+      last[r] = done;
+    }
+    /* Totals over every list */
+    size_t len = 0;
+    int waiting[3] = {0, 0, 0};
+    for (size_t i = 0; i < cfg->wl.lists; i++) {
+      llist *list = run_list(cfg, i);
+      len += atomic_load(&list->len);
+      waiting[ROLE_SEARCHER] += atomic_load(&list->st.searchers_waiting);
+      waiting[ROLE_INSERTER] += atomic_load(&list->st.inserters_waiting);
+      waiting[ROLE_DELETER] += atomic_load(&list->st.deleters_waiting);
+    }
+    printf("[%7.1fs] search %.0f/s, insert %.0f/s, delete %.0f/s, list %zu, "
+           "waiting %d:%d:%d%s\n",
+           (double)(now - start) / 1e9, rate[ROLE_SEARCHER],
+           rate[ROLE_INSERTER], rate[ROLE_DELETER], len,
+           waiting[ROLE_SEARCHER], waiting[ROLE_INSERTER],
+           waiting[ROLE_DELETER],
+           now < cfg->measure_start_ns ? " (warmup)" : "");
+    fflush(stdout);
+    prev = now;
+  }
+
+  return NULL;
+}
+
+static void print_latency(const char *name, const histogram *h) {
+  if (h->count == 0) {
+    return;
+  }
+  printf("    %s latency: mean %.1f us, p50 %.1f us, p99 %.1f us, p999 %.1f "
+         "us, max %.1f us\n",
+         name, histogram_mean(h) / 1e3,
+         (double)histogram_percentile(h, 50) / 1e3,
+         (double)histogram_percentile(h, 99) / 1e3,
+         (double)histogram_percentile(h, 99.9) / 1e3, (double)h->max / 1e3);
+}
+
+/* Prints how many operations of each role were turned away, if any limit was
+set */
+static void print_admission(const run_cfg *cfg) {
+  const admission *a = &cfg->admission;
+  if (a->limit[0] == 0 && a->limit[1] == 0 && a->limit[2] == 0) {
+    return;
+  }
+  const char *policies[] = {"reject", "block", "drop-oldest"};
+  printf("    Queue limits: %zu:%zu:%zu, overload: %s\n", a->limit[0],
+         a->limit[1], a->limit[2], policies[a->policy]);
+  printf("    Rejected: %zu:%zu:%zu, dropped: %zu:%zu:%zu\n",
+         atomic_load(&a->rejected[0]), atomic_load(&a->rejected[1]),
+         atomic_load(&a->rejected[2]), atomic_load(&a->dropped[0]),
+         atomic_load(&a->dropped[1]), atomic_load(&a->dropped[2]));
+}
+
+static void print_summary(const run_cfg *cfg) {
+  printf("SUMMARY:\n");
+  /* Dropped operations were issued but never ran */
+  size_t ops = cfg->searchers.len + cfg->inserters.len + cfg->deleters.len;
+  size_t measured = 0;
+  for (int r = 0; r < 3; r++) {
+    ops -= atomic_load(&cfg->admission.dropped[r]);
+    measured += cfg->latency[r].count;
+  }
+  printf("    Operations: %zu on %zu %s\n", ops, cfg->threads,
+         cfg->coroutines ? "executor threads, as coroutines" : "threads");
+  printf("    Placement: %s\n", cfg->placement.spec);
+  if (cfg->warmup > 0) {
+    printf("    Warmup: %.1f s, %zu operations excluded\n", cfg->warmup,
+           atomic_load(&cfg->warmup_ops));
+  }
+  if (measured != 0 && cfg->elapsed_ns != 0) {
+    printf("    Throughput: %.1f operations/s\n",
+           (double)measured * 1e9 / (double)cfg->elapsed_ns);
+  }
+  print_latency("Searcher", &cfg->latency[ROLE_SEARCHER]);
+  print_latency("Inserter", &cfg->latency[ROLE_INSERTER]);
+  print_latency("Deleter", &cfg->latency[ROLE_DELETER]);
+  /* Only worth telling apart if there are both */
+  if (cfg->class_latency[PRIORITY_BACKGROUND].count != 0 &&
+      cfg->class_latency[PRIORITY_INTERACTIVE].count != 0) {
+    print_latency("Interactive", &cfg->class_latency[PRIORITY_INTERACTIVE]);
+    print_latency("Background", &cfg->class_latency[PRIORITY_BACKGROUND]);
+  }
+  printf("    Searchers: %zu, inserters: %zu, deleters: %zu\n",
+         cfg->searchers.len, cfg->inserters.len, cfg->deleters.len);
+  if (cfg->list_ids != NULL) {
+    size_t len = 0;
+    for (size_t i = 0; i < cfg->wl.lists; i++) {
+      len += atomic_load(&run_list(cfg, i)->len);
+    }
+    printf("    Lists: %zu, %zu values in total\n", cfg->wl.lists, len);
+  }
+  const llist *list = cfg->list;
+  if (list->dense) {
+    printf("    List: %zu values, keys %zu to %zu dense, %zu nodes\n",
+           atomic_load(&list->len), list->dense_lo,
+           list->dense_lo + list->dense_len - 1, list->nodes);
+  } else if (list->counted || list->dense_range != 0) {
+    printf("    List: %zu values in %zu nodes\n", atomic_load(&list->len),
+           list->nodes);
+  }
+  print_admission(cfg);
+  if (cfg->batch_searches && cfg->batch.scans != 0) {
+    printf("    Search scans: %zu for %zu searches (%.1f per scan)\n",
+           cfg->batch.scans, cfg->batch.searches,
+           (double)cfg->batch.searches / (double)cfg->batch.scans);
+  }
+  if (cfg->coroutines) {
+    printf("    Parked waiting for the list: %zu\n", cfg->executor.parks);
+  } else {
+    printf("    Taken from own inbox: %zu\n", cfg->pool.inboxed);
+    printf("    Stolen from other threads: %zu\n", cfg->pool.steals);
+  }
+  printf("    Seed: %llu\n", (unsigned long long)cfg->wl.seed);
+}
+
+/* Makes the running run stop issuing operations, after which it drains the
+ones in flight and finishes as usual. Only sets a flag, so it's safe to call
+from a signal handler */
+void run_cfg_stop(void) { stopping = 1; }
+
+void run_cfg_run(run_cfg *cfg) {
+  stopping = 0;
+  if (!cfg->quiet) {
+    printf("Seed: %llu\n", (unsigned long long)cfg->wl.seed);
+  }
+  /* The reports replace the state printed after every event */
+  if (!cfg->quiet && cfg->report_interval <= 0) {
+    cfg->log = event_log_new(cfg->list, EVENT_LOG_DEFAULT_CAP);
+    cfg->list->st.log = cfg->log;
+  }
+
+  if (cfg->trace_path != NULL) {
+    ctrace_enable();
+  }
+
+  if (cfg->publish_metrics) {
+    metrics *m = metrics_create(getpid());
+    for (size_t i = 0; i < cfg->wl.lists; i++) {
+      run_list(cfg, i)->st.metrics = m;
+    }
+    if (m != NULL) {
+      size_t len = 0;
+      for (size_t i = 0; i < cfg->wl.lists; i++) {
+        len += atomic_load(&run_list(cfg, i)->len);
+      }
+      metrics_set(&m->list_len, (int64_t)len);
+      fprintf(stderr, "Publishing metrics, watch them with mc504-stat %ld\n",
+              (long)getpid());
+    }
+  }
+
+  if (cfg->threads == 0) {
+    cfg->threads = 1;
+  }
+  uint64_t start = clock_ns();
+  cfg->measure_start_ns = start + (uint64_t)(cfg->warmup * 1e9);
+  atomic_init(&cfg->warmup_ops, 0);
+  for (int r = 0; r < 3; r++) {
+    atomic_init(&cfg->completed[r], 0);
+  }
+  if (cfg->record_path != NULL) {
+    cfg->recording = op_trace_new(cfg->list, cfg->threads, start);
+  }
+  cfg->thread_latency = calloc(cfg->threads * 3, sizeof(histogram));
+  cfg->thread_class_latency = calloc(cfg->threads * 2, sizeof(histogram));
+  admission_init(&cfg->admission, cfg->overload, cfg->queue_limit);
+  if (cfg->batch_searches) {
+    search_batch_init(&cfg->batch);
+    cfg->list->st.batch = &cfg->batch;
+  }
+  if (cfg->coroutines) {
+    executor_init(&cfg->executor, cfg->threads, &cfg->placement);
+    cfg->executor.on_done = exec_op_done;
+    cfg->executor.on_done_arg = cfg;
+    for (size_t i = 0; i < cfg->wl.lists; i++) {
+      run_list(cfg, i)->st.executor = &cfg->executor;
+    }
+  } else {
+    worker_pool_init_placed(&cfg->pool, cfg->threads, &cfg->placement);
+    cfg->pool.on_done = task_done;
+    cfg->pool.on_done_arg = cfg;
+  }
+
+  /* A closed-loop workload keeps as many operations in flight as there are
+  threads, unless told otherwise. A replay follows the recorded times instead */
+  int closed = cfg->replay == NULL && cfg->wl.arrival == ARRIVAL_CLOSED;
+  if (closed) {
+    size_t outstanding =
+        cfg->wl.outstanding != 0 ? cfg->wl.outstanding : cfg->threads;
+    sem_new(&cfg->outstanding, (int)outstanding);
+  }
+
+  if (cfg->report_interval > 0 && !cfg->quiet) {
+    sem_new(&cfg->reporter_done, 0);
+    pthread_create(&cfg->reporter, NULL, reporter_thread, cfg);
+  }
+
+  if (cfg->replay != NULL) {
+    issue_replay(cfg);
+  } else {
+    issue(cfg);
+  }
+
+  if (cfg->coroutines) {
+    executor_join(&cfg->executor);
+    for (size_t i = 0; i < cfg->wl.lists; i++) {
+      run_list(cfg, i)->st.executor = NULL;
+    }
+  } else {
+    worker_pool_join(&cfg->pool);
+  }
+  /* Nothing was measured if the run ended during the warmup */
+  uint64_t end = clock_ns();
+  cfg->elapsed_ns =
+      end > cfg->measure_start_ns ? end - cfg->measure_start_ns : 0;
+  if (cfg->report_interval > 0 && !cfg->quiet) {
+    sem_release(&cfg->reporter_done);
+    pthread_join(cfg->reporter, NULL);
+    sem_destroy(&cfg->reporter_done);
+  }
+  if (closed) {
+    sem_destroy(&cfg->outstanding);
+  }
+  admission_destroy(&cfg->admission);
+  if (cfg->batch_searches) {
+    cfg->list->st.batch = NULL;
+    search_batch_destroy(&cfg->batch);
+  }
+
+  for (size_t i = 0; i < cfg->threads * 3; i++) {
+    histogram_merge(&cfg->latency[i % 3], &cfg->thread_latency[i]);
+  }
+  free(cfg->thread_latency);
+  cfg->thread_latency = NULL;
+  for (size_t i = 0; i < cfg->threads * 2; i++) {
+    histogram_merge(&cfg->class_latency[i % 2], &cfg->thread_class_latency[i]);
+  }
+  free(cfg->thread_class_latency);
+  cfg->thread_class_latency = NULL;
+
+  if (cfg->log != NULL) {
+    cfg->list->st.log = NULL;
+    event_log_free(cfg->log);
+    cfg->log = NULL;
+  }
+
+  if (cfg->list->st.metrics != NULL) {
+    metrics_destroy(cfg->list->st.metrics);
+    for (size_t i = 0; i < cfg->wl.lists; i++) {
+      run_list(cfg, i)->st.metrics = NULL;
     }
   }
 
-  worker_queue_join(cfg->searchers);
-  worker_queue_join(cfg->inserters);
-  worker_queue_join(cfg->deleters);
+  if (!cfg->quiet) {
+    print_summary(cfg);
+  }
 
-  llist_free(cfg->list);
+  if (cfg->trace_path != NULL && ctrace_write(cfg->trace_path) == 0) {
+    printf("Trace written to %s\n", cfg->trace_path);
+  }
+  if (cfg->recording != NULL) {
+    if (op_trace_write(cfg->recording, cfg->record_path) == 0) {
+      printf("Operations recorded to %s\n", cfg->record_path);
+    }
+    op_trace_free(cfg->recording);
+    cfg->recording = NULL;
+  }
+
+  if (cfg->list_ids != NULL) {
+    keyspace_destroy(&cfg->keyspace);
+    free(cfg->list_ids);
+    cfg->list_ids = NULL;
+  } else {
+    llist_free(cfg->list);
+  }
 }
@@ -1,30 +1,210 @@
+#ifndef _SCHED_INCLUDE_H
+#define _SCHED_INCLUDE_H
+
+#include "admission.h"
+#include "affinity.h"
+#include "deque.h"
+#include "events.h"
+#include "executor.h"
+#include "histogram.h"
+#include "keyspace.h"
+#include "op-trace.h"
+#include "rng.h"
+#include "search-batch.h"
 #include "workers.h"
+#include "workload.h"
 #include "linked-list.h"
 #include <stdlib.h>
 
 typedef void*(*thread_fn)(void*);
 
-/* Buffer that holds all the workers of a given type */
+llist *llist_random(size_t size, size_t random_upper_bound, uint64_t seed,
+                    const llist_opts *opts);
+
+/* A single operation, executed by calling function with ctx, which returned
+result. issued_ns is when it was submitted, dropped is set if its admission
+ticket was dropped before it started, in which case function wasn't called */
+typedef struct {
+  thread_fn function;
+  llist_ctx ctx;
+  uint64_t issued_ns;
+  int dropped;
+  void *result;
+} task;
+
+struct worker_pool;
+
+/* A pool thread, the deque it owns and its inbox, where tasks submitted from
+outside the pool are dealt. Only the owner pushes to tasks, while pushes to
+inbox are serialized by inbox_lock, so both the owner and thieves take from
+inbox with deque_steal */
+typedef struct {
+  struct worker_pool *pool;
+  pthread_t thread;
+  deque tasks;
+  deque inbox;
+  pthread_mutex_t inbox_lock;
+  /* Generator for picking random victims */
+  rng rng;
+  /* Number of tasks this thread stole from other threads and took from its
+  own inbox, read after join */
+  size_t steals;
+  size_t inboxed;
+  /* Whether the thread is pinned to the CPUs of writers (1), of searchers (0)
+  or neither (-1), only used with AFFINITY_SPLIT */
+  int group;
+} pool_worker;
+
+/*
+Fixed-size pool of threads which execute tasks with work stealing.
+
+Every thread owns a Chase-Lev deque: tasks submitted from a pool thread are
+pushed to its own deque, while tasks submitted from outside the pool are dealt
+round-robin to the threads' inboxes, next_inbox being the next one. A thread
+first takes from its own deque, then from its inbox and, when both are empty,
+steals from the deques and inboxes of random victims.
+
+Background tasks (see op_priority) all go to the background deque, which a
+thread only steals from after failing to find a task anywhere else for a whole
+round of victims, so interactive tasks are taken first.
+
+available counts the tasks which haven't been claimed yet, so idle threads
+sleep on it instead of spinning, and every thread that acquires it is sure to
+find a task somewhere. Each task still runs through the usual
+acquire/operate/release sequence of the worker functions, so the number of
+operations is unrelated to the number of threads.
+
+If placement is set, threads are pinned to CPUs according to it.
+*/
+typedef struct worker_pool {
+  size_t nthreads;
+  pool_worker *workers;
+  atomic_size_t next_inbox;
+  deque background;
+  pthread_mutex_t background_lock;
+  sem_t available;
+  /* Tasks submitted but not finished yet, idle is posted when it drops to 0 */
+  atomic_size_t pending;
+  sem_t idle;
+  atomic_int stop;
+  const affinity *placement;
+  /* Called by the pool thread after each task, if set, with the index of the
+  thread */
+  void (*on_done)(void *arg, const task *t, size_t thread);
+  void *on_done_arg;
+  /* Tasks submitted from outside the pool */
+  atomic_size_t submitted;
+  size_t steals;
+  size_t inboxed;
+} worker_pool;
+
+void worker_pool_init(worker_pool *pool, size_t nthreads);
+void worker_pool_init_placed(worker_pool *pool, size_t nthreads,
+                             const affinity *placement);
+void worker_pool_submit(worker_pool *pool, thread_fn f, llist_ctx ctx);
+void worker_pool_join(worker_pool *pool);
+
+/* Number of operations of a given type issued by a run, each of which does the
+same simulated work */
 typedef struct {
-  size_t cap;
   size_t len;
   llist* list;
-  pthread_t *threads;
-  llist_ctx *ctxs;
+  work_model work;
   thread_fn function;
 } worker_queue;
 
-worker_queue worker_queue_new(size_t cap, llist*, thread_fn f);
+worker_queue worker_queue_new(llist*, thread_fn f);
+
+/* Configuration for a run, contains the workload which says how many
+searchers, inserters and deleters should be issued and with which keys, as
+well as the number of threads in the pool which executes them (by default one
+per operation, up to 64). The run's state is printed by the log's consumer
+thread, unless quiet is set, in which case nothing is printed and the results
+are only left in latency and elapsed_ns. If trace_path is set, a Chrome
+trace of every worker's phases is written there at the end of the run. If
+publish_metrics is set, live counters are published in shared memory for
+mc504-stat while the run is going.
 
-/* Configuration for a run, contains the number of searcher, inserters and
-deleters which sould be created, as well as the initial list size */
+If record_path is set, every operation is recorded to an operation trace
+written there at the end of the run. A run created by run_cfg_replay_new issues
+the operations of a recorded trace instead of drawing them from the workload,
+at replay_speed times the original speed (0 issues them as fast as possible).
+
+queue_limit bounds the operations of each role which were issued but aren't
+done yet, with overload saying what happens to the ones over the limit (see
+admission.h). By default there is no limit.
+
+The first warmup seconds of the run are excluded from the latency and
+throughput statistics: operations issued during them still run, and are still
+recorded to the operation trace, but aren't measured. For duration-based runs the warmup comes on top of the duration. If
+report_interval is set, the throughput of each role, the list length and the
+waiting counts are printed every report_interval seconds, instead of the state
+after every event. In any case, once the run stops issuing, whether it's done
+or run_cfg_stop was called, every operation in flight is drained before the
+summary is printed and the list is freed.
+
+If batch_searches is set, concurrent searches are answered together by shared
+traversals of the list (see search-batch.h).
+
+If the workload has more than one list, they are registered in keyspace as
+list-0, list-1, ..., whose ids are in list_ids, and every operation addresses
+its list by id. list is then list-0, which is the one the event log follows.
+Batched searches, recording and replays need a single list */
 typedef struct {
-  size_t initial_size;
+  workload wl;
   llist *list;
+  keyspace keyspace;
+  size_t *list_ids;
+  event_log *log;
+  const char *trace_path;
+  int publish_metrics;
+  size_t threads;
+  worker_pool pool;
   worker_queue searchers;
   worker_queue inserters;
   worker_queue deleters;
+  /* Limits the operations in flight of a closed-loop workload */
+  sem_t outstanding;
+  const char *record_path;
+  op_trace *recording;
+  op_trace *replay;
+  double replay_speed;
+  int quiet;
+  /* Run the operations as coroutines on an executor instead of the pool */
+  int coroutines;
+  executor executor;
+  int batch_searches;
+  search_batch batch;
+  size_t queue_limit[3];
+  overload_policy overload;
+  admission admission;
+  /* Placement of the pool threads, by default none */
+  affinity placement;
+  /* Time between issue and completion of the operations of each role, and of
+  each priority class in class_latency. Every pool thread records to its own
+  histograms in thread_latency and thread_class_latency, which are merged at
+  the end of the run */
+  histogram *thread_latency;
+  histogram latency[3];
+  histogram *thread_class_latency;
+  histogram class_latency[2];
+  /* How long the run took, from the end of the warmup until the last
+  operation is done */
+  uint64_t elapsed_ns;
+  double warmup;
+  uint64_t measure_start_ns;
+  /* Operations issued during the warmup, which aren't in the statistics */
+  atomic_size_t warmup_ops;
+  double report_interval;
+  /* Operations of each role done so far, only counted for the reports */
+  atomic_size_t completed[3];
+  pthread_t reporter;
+  sem_t reporter_done;
 } run_cfg;
 
-run_cfg run_cfg_new(size_t init, size_t s, size_t i, size_t d, size_t random_upper_bound);
-void run_cfg_run(run_cfg* cfg, size_t random_upper_bound);
+run_cfg run_cfg_new(const workload *wl);
+run_cfg run_cfg_replay_new(const workload *wl, op_trace *tr, double speed);
+void run_cfg_run(run_cfg* cfg);
+void run_cfg_stop(void);
+
+#endif
@@ -0,0 +1,82 @@
+#define _POSIX_C_SOURCE 200809L
+#include "search-batch.h"
+#include "sync.h"
+
+void search_batch_init(search_batch *b) {
+  mutex_new(&b->lock);
+  cond_new(&b->changed);
+  b->len = 0;
+  b->seq = 0;
+  b->scanned = 0;
+  b->scanning = 0;
+  b->scans = 0;
+  b->searches = 0;
+}
+
+void search_batch_destroy(search_batch *b) {
+  pthread_cond_destroy(&b->changed);
+  pthread_mutex_destroy(&b->lock);
+}
+
+/* Closes the open batch and answers it. Must be called with the lock held,
+which is released during the traversal */
+static void lead(search_batch *b, llist *list) {
+  size_t keys[SEARCH_BATCH_MAX];
+  lnode **results[SEARCH_BATCH_MAX];
+  lnode *found[SEARCH_BATCH_MAX];
+  size_t n = b->len;
+  size_t seq = b->seq;
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = b->keys[i];
+    results[i] = b->results[i];
+  }
+  b->len = 0;
+  b->seq++;
+  b->scanning = 1;
+  /* Searchers waiting for room can join the new batch */
+  cond_broadcast(&b->changed);
+  mutex_release(&b->lock);
+
+  llist_find_many(list, keys, n, found);
+
+  mutex_acquire(&b->lock);
+  for (size_t i = 0; i < n; i++) {
+    *results[i] = found[i];
+  }
+  b->scanned = seq + 1;
+  b->scanning = 0;
+  b->scans++;
+  b->searches += n;
+  cond_broadcast(&b->changed);
+}
+
+/*
+Same as llist_find, but answered together with the other searches arriving at
+the same time. The caller must hold the list as a searcher, which it keeps
+while waiting, so the list can't change under the leader's traversal in ways a
+searcher couldn't already see.
+*/
+lnode *search_batch_find(search_batch *b, llist *list, size_t value) {
+  lnode *result = NULL;
+
+  mutex_acquire(&b->lock);
+  while (b->len == SEARCH_BATCH_MAX) {
+    cond_wait(&b->changed, &b->lock);
+  }
+  size_t seq = b->seq;
+  b->keys[b->len] = value;
+  b->results[b->len] = &result;
+  b->len++;
+
+  while (b->scanned <= seq) {
+    if (!b->scanning && b->seq == seq) {
+      lead(b, list);
+    } else {
+      cond_wait(&b->changed, &b->lock);
+    }
+  }
+  mutex_release(&b->lock);
+
+  return result;
+}
@@ -0,0 +1,45 @@
+#ifndef _SEARCH_BATCH_INCLUDE_H
+#define _SEARCH_BATCH_INCLUDE_H
+
+#include "linked-list.h"
+#include <pthread.h>
+#include <stddef.h>
+
+/* Most searches answered by a single traversal */
+#define SEARCH_BATCH_MAX 64
+
+/*
+Groups concurrent searches so a single traversal answers all of them.
+
+Searchers which already hold the list add their key to the open batch. If no
+scan is running, the searcher becomes the leader: it closes the batch, looks up
+every key in it with llist_find_many and hands each searcher its result.
+Searchers arriving during a scan wait for it in the next batch, and once it's
+done one of them leads the next scan, so the more searches arrive at the same
+time the more each traversal answers.
+
+Each searcher gives a pointer to where its result is written, so batches can
+be reused as soon as they're closed. Batches are numbered in open order, and
+scanned counts how many were answered, which is also in order since only one
+scan runs at a time. Everything is protected by lock.
+*/
+typedef struct search_batch {
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  /* The open batch, numbered seq */
+  size_t keys[SEARCH_BATCH_MAX];
+  lnode **results[SEARCH_BATCH_MAX];
+  size_t len;
+  size_t seq;
+  size_t scanned;
+  int scanning;
+  /* Totals, read after the run */
+  size_t scans;
+  size_t searches;
+} search_batch;
+
+void search_batch_init(search_batch *b);
+void search_batch_destroy(search_batch *b);
+lnode *search_batch_find(search_batch *b, llist *list, size_t value);
+
+#endif
@@ -0,0 +1,471 @@
+#define _GNU_SOURCE
+#include "server.h"
+#include "protocol.h"
+#include "sync.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_MAX_EVENTS 64
+
+typedef struct conn {
+  int fd;
+  /* A request cut in the middle by the last read */
+  unsigned char partial[PROTOCOL_REQUEST_SIZE];
+  size_t partial_len;
+  /* Responses not written yet, protected by lock */
+  pthread_mutex_t lock;
+  unsigned char *out;
+  size_t out_len;
+  size_t out_cap;
+  /* Whether the connection is queued to be flushed, protected by lock */
+  int queued;
+  /* Set once the loop closed the connection, responses are dropped after */
+  int closed;
+  /* Whether the loop stopped reading it for having too many requests running
+  or responses waiting, only used by the loop */
+  int paused;
+  atomic_size_t inflight;
+  /* One reference for the loop, one per request running and one while it's
+  queued to be flushed */
+  atomic_size_t refs;
+  struct conn *next_queued;
+  /* Open connections, only used by the loop. Closed ones stay in a list of
+  their own until the events being processed are done with them */
+  struct conn *prev_open;
+  struct conn *next_open;
+} conn;
+
+/* What a request's operation carries in its context's tag */
+typedef struct {
+  conn *c;
+  uint32_t seq;
+} request_tag;
+
+static void conn_unref(conn *c) {
+  if (atomic_fetch_sub(&c->refs, 1) == 1) {
+    pthread_mutex_destroy(&c->lock);
+    free(c->out);
+    free(c);
+  }
+}
+
+/* Tells epoll what the loop wants from c, must be called with c->lock held */
+static void conn_watch(server *s, conn *c) {
+  struct epoll_event ev = {.data.ptr = c};
+  ev.events = (c->paused ? 0u : (uint32_t)EPOLLIN) |
+              (c->out_len > 0 ? (uint32_t)EPOLLOUT : 0u);
+  if (epoll_ctl(s->epfd, EPOLL_CTL_MOD, c->fd, &ev) < 0) {
+    perror("Failed to watch connection");
+    exit(1);
+  }
+}
+
+/* Writes as much of c's output as the socket takes, returns -1 if the
+connection broke. Must be called with c->lock held */
+static int conn_write(conn *c) {
+  size_t sent = 0;
+
+  while (sent < c->out_len) {
+    ssize_t n = send(c->fd, c->out + sent, c->out_len - sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    sent += (size_t)n;
+  }
+  memmove(c->out, c->out + sent, c->out_len - sent);
+  c->out_len -= sent;
+  return 0;
+}
+
+/* Must be called with c->lock held */
+static void append_response(conn *c, const protocol_response *res) {
+  if (c->out_len + PROTOCOL_RESPONSE_SIZE > c->out_cap) {
+    c->out_cap = c->out_cap != 0 ? 2 * c->out_cap : 1024;
+    c->out = realloc(c->out, c->out_cap);
+  }
+  protocol_encode_response(res, c->out + c->out_len);
+  c->out_len += PROTOCOL_RESPONSE_SIZE;
+}
+
+/* Whether the loop should stop reading c, must be called with c->lock held */
+static int conn_saturated(conn *c) {
+  return atomic_load(&c->inflight) >= SERVER_MAX_INFLIGHT ||
+         c->out_len >= SERVER_MAX_OUTPUT;
+}
+
+/* Writes what the socket takes of c's output, resumes reading c if it was
+paused and is down to half of both limits, and tells epoll what to wait for.
+Returns -1 if the connection broke. Must be called with c->lock held */
+static int conn_flush(server *s, conn *c) {
+  if (conn_write(c) < 0) {
+    return -1;
+  }
+  if (c->paused && atomic_load(&c->inflight) < SERVER_MAX_INFLIGHT / 2 &&
+      c->out_len < SERVER_MAX_OUTPUT / 2) {
+    c->paused = 0;
+  }
+  conn_watch(s, c);
+  return 0;
+}
+
+static void conn_close(server *s, conn *c) {
+  epoll_ctl(s->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+  mutex_acquire(&c->lock);
+  c->closed = 1;
+  c->out_len = 0;
+  mutex_release(&c->lock);
+  close(c->fd);
+
+  if (c->prev_open != NULL) {
+    c->prev_open->next_open = c->next_open;
+  } else {
+    s->open = c->next_open;
+  }
+  if (c->next_open != NULL) {
+    c->next_open->prev_open = c->prev_open;
+  }
+  c->next_open = s->closed;
+  s->closed = c;
+}
+
+/* Drops the loop's reference to the connections closed so far */
+static void reap(server *s) {
+  while (s->closed != NULL) {
+    conn *c = s->closed;
+    s->closed = c->next_open;
+    conn_unref(c);
+  }
+}
+
+/* Called by the pool thread which ran a request's operation */
+static void request_done(void *arg, const task *t, size_t thread) {
+  (void)thread;
+  server *s = arg;
+  request_tag *tag = t->ctx.tag;
+  conn *c = tag->c;
+  protocol_response res = {.seq = tag->seq, .status = PROTOCOL_OK};
+  free(tag);
+
+  if (t->function == searcher_thread) {
+    res.status = t->result != NULL ? PROTOCOL_OK : PROTOCOL_MISS;
+  } else if (t->function == deleter_thread) {
+    res.status = *(int *)t->result ? PROTOCOL_OK : PROTOCOL_MISS;
+  }
+  atomic_fetch_add_explicit(&s->served, 1, memory_order_relaxed);
+
+  int queue = 0;
+  mutex_acquire(&c->lock);
+  if (!c->closed) {
+    append_response(c, &res);
+    queue = !c->queued;
+    c->queued = 1;
+  }
+  atomic_fetch_sub(&c->inflight, 1);
+  mutex_release(&c->lock);
+
+  if (!queue) {
+    conn_unref(c);
+    return;
+  }
+  /* The request's reference is now the queue's */
+  mutex_acquire(&s->queue_lock);
+  c->next_queued = s->queue;
+  s->queue = c;
+  mutex_release(&s->queue_lock);
+  uint64_t one = 1;
+  if (write(s->wake_fd, &one, sizeof(one)) < 0) {
+    perror("Failed to wake up the loop");
+    exit(1);
+  }
+}
+
+/* Writes the responses of every queued connection, and resumes reading the
+ones that caught up */
+static void flush_queued(server *s) {
+  uint64_t wakes;
+  if (read(s->wake_fd, &wakes, sizeof(wakes)) < 0 && errno != EAGAIN) {
+    perror("Failed to read the wake counter");
+    exit(1);
+  }
+
+  mutex_acquire(&s->queue_lock);
+  conn *c = s->queue;
+  s->queue = NULL;
+  mutex_release(&s->queue_lock);
+
+  while (c != NULL) {
+    conn *next = c->next_queued;
+    int broken = 0;
+    mutex_acquire(&c->lock);
+    c->queued = 0;
+    if (!c->closed) {
+      broken = conn_flush(s, c) < 0;
+    }
+    int closed = c->closed;
+    mutex_release(&c->lock);
+    if (broken && !closed) {
+      conn_close(s, c);
+    }
+    conn_unref(c);
+    c = next;
+  }
+}
+
+static void accept_all(server *s) {
+  for (;;) {
+    int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        perror("Failed to accept connection");
+      }
+      return;
+    }
+
+    conn *c = calloc(1, sizeof(*c));
+    c->fd = fd;
+    mutex_new(&c->lock);
+    atomic_init(&c->inflight, 0);
+    atomic_init(&c->refs, 1);
+    c->next_open = s->open;
+    if (s->open != NULL) {
+      s->open->prev_open = c;
+    }
+    s->open = c;
+    s->accepted++;
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      perror("Failed to watch connection");
+      exit(1);
+    }
+  }
+}
+
+/* Submits the request in buf to the pool, or answers it right away if it's
+invalid */
+static void submit(server *s, conn *c, const unsigned char *buf) {
+  static const thread_fn functions[3] = {
+      [PROTOCOL_SEARCH] = searcher_thread,
+      [PROTOCOL_INSERT] = inserter_thread,
+      [PROTOCOL_DELETE] = deleter_thread,
+  };
+  protocol_request req;
+  protocol_decode_request(buf, &req);
+
+  if (req.op > PROTOCOL_DELETE || req.key == 0) {
+    protocol_response res = {.seq = req.seq, .status = PROTOCOL_BAD_REQUEST};
+    mutex_acquire(&c->lock);
+    append_response(c, &res);
+    mutex_release(&c->lock);
+    return;
+  }
+
+  request_tag *tag = malloc(sizeof(*tag));
+  tag->c = c;
+  tag->seq = req.seq;
+  atomic_fetch_add(&c->refs, 1);
+  atomic_fetch_add(&c->inflight, 1);
+  worker_pool_submit(&s->pool, functions[req.op],
+                     (llist_ctx){.list = s->list,
+                                 .value = (size_t)req.key,
+                                 .tag = tag});
+}
+
+/* Reads every request c sent so far and submits them, unless it saturates
+first */
+static void conn_read(server *s, conn *c) {
+  unsigned char buf[PROTOCOL_REQUEST_SIZE * 256];
+
+  for (;;) {
+    mutex_acquire(&c->lock);
+    int saturated = conn_saturated(c);
+    mutex_release(&c->lock);
+    if (saturated) {
+      break;
+    }
+
+    ssize_t n = read(c->fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (n <= 0) {
+      /* The client hung up, or the connection broke */
+      conn_close(s, c);
+      return;
+    }
+
+    size_t len = (size_t)n;
+    size_t pos = 0;
+    if (c->partial_len > 0) {
+      size_t missing = PROTOCOL_REQUEST_SIZE - c->partial_len;
+      size_t take = missing < len ? missing : len;
+      memcpy(c->partial + c->partial_len, buf, take);
+      c->partial_len += take;
+      pos = take;
+      if (c->partial_len < PROTOCOL_REQUEST_SIZE) {
+        continue;
+      }
+      submit(s, c, c->partial);
+      c->partial_len = 0;
+    }
+    for (; pos + PROTOCOL_REQUEST_SIZE <= len; pos += PROTOCOL_REQUEST_SIZE) {
+      submit(s, c, buf + pos);
+    }
+    memcpy(c->partial, buf + pos, len - pos);
+    c->partial_len = len - pos;
+  }
+
+  mutex_acquire(&c->lock);
+  /* Whatever is left in the socket waits until c caught up */
+  c->paused = conn_saturated(c);
+  int broken = conn_flush(s, c) < 0;
+  mutex_release(&c->lock);
+  if (broken) {
+    conn_close(s, c);
+  }
+}
+
+/* Writes c's pending responses once the socket has room again */
+static void conn_drain(server *s, conn *c) {
+  mutex_acquire(&c->lock);
+  int broken = conn_flush(s, c) < 0;
+  mutex_release(&c->lock);
+  if (broken) {
+    conn_close(s, c);
+  }
+}
+
+static int listen_on(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    perror("Failed to create socket");
+    return -1;
+  }
+  /* A previous server may have left its socket behind */
+  unlink(path);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    perror("Failed to listen on socket");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Listens on path and starts threads pool threads which run the requests on
+list, returns -1 if the socket can't be set up */
+int server_init(server *s, llist *list, const char *path, size_t threads) {
+  *s = (server){.list = list, .path = path};
+  s->listen_fd = listen_on(path);
+  if (s->listen_fd < 0) {
+    return -1;
+  }
+  s->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  s->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (s->wake_fd < 0 || s->epfd < 0) {
+    perror("Failed to set up the event loop");
+    close(s->listen_fd);
+    unlink(path);
+    return -1;
+  }
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &s->listen_fd};
+  epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->listen_fd, &ev);
+  ev.data.ptr = &s->wake_fd;
+  epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->wake_fd, &ev);
+  mutex_new(&s->queue_lock);
+  atomic_init(&s->stopping, 0);
+  atomic_init(&s->served, 0);
+
+  worker_pool_init(&s->pool, threads);
+  s->pool.on_done = request_done;
+  s->pool.on_done_arg = s;
+  return 0;
+}
+
+/* Runs the loop until server_stop is called */
+void server_run(server *s) {
+  struct epoll_event events[SERVER_MAX_EVENTS];
+
+  while (!atomic_load(&s->stopping)) {
+    int n = epoll_wait(s->epfd, events, SERVER_MAX_EVENTS, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("Failed to wait for events");
+      exit(1);
+    }
+
+    for (int i = 0; i < n; i++) {
+      void *ptr = events[i].data.ptr;
+      if (ptr == &s->listen_fd) {
+        accept_all(s);
+      } else if (ptr == &s->wake_fd) {
+        flush_queued(s);
+      } else if (((conn *)ptr)->closed) {
+        /* Closed by an earlier event of this round */
+        continue;
+      } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        conn_close(s, ptr);
+      } else {
+        /* Reads may close it, in which case there is nothing to write */
+        if (events[i].events & EPOLLOUT) {
+          conn_drain(s, ptr);
+        } else if (events[i].events & EPOLLIN) {
+          conn_read(s, ptr);
+        }
+      }
+    }
+    reap(s);
+  }
+}
+
+/* Makes server_run return, safe to call from a signal handler */
+void server_stop(server *s) {
+  atomic_store(&s->stopping, 1);
+  uint64_t one = 1;
+  /* Only wakes up the loop, nothing to do if it fails */
+  ssize_t n = write(s->wake_fd, &one, sizeof(one));
+  (void)n;
+}
+
+/* Stops taking requests, lets the ones running finish, sends what can be sent
+without blocking and closes every connection. The list is left to the
+caller */
+void server_shutdown(server *s) {
+  close(s->listen_fd);
+  unlink(s->path);
+  worker_pool_join(&s->pool);
+  flush_queued(s);
+  while (s->open != NULL) {
+    conn_close(s, s->open);
+  }
+  reap(s);
+
+  close(s->wake_fd);
+  close(s->epfd);
+  pthread_mutex_destroy(&s->queue_lock);
+}
@@ -0,0 +1,58 @@
+#ifndef _SERVER_INCLUDE_H
+#define _SERVER_INCLUDE_H
+
+#include "linked-list.h"
+#include "sched.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+Serves a single list to many client processes over a UNIX domain socket, with
+the binary protocol of protocol.h.
+
+One thread runs an epoll loop (server_run) which accepts connections and reads
+their requests, and hands every request to the worker pool as a regular
+operation, so it goes through the same acquire/operate/release path as the
+operations of a run. The pool thread which finishes an operation appends its
+response to the connection's output and, unless the connection is already
+queued, queues it to be flushed and wakes the loop through an eventfd. The loop
+then writes all the pending responses of a connection at once, so pipelined
+requests get their responses back in as few writes as possible.
+
+Only the loop reads from and writes to the sockets. A connection isn't read
+while SERVER_MAX_INFLIGHT of its requests are running or SERVER_MAX_OUTPUT
+bytes of its responses are waiting to be sent, so a client can't make the
+server queue more than that on its behalf, even if it never reads. Reading
+resumes once both are down to half.
+*/
+
+#define SERVER_MAX_INFLIGHT 1024
+#define SERVER_MAX_OUTPUT (64 * 1024)
+
+struct conn;
+
+typedef struct {
+  llist *list;
+  const char *path;
+  int epfd;
+  int listen_fd;
+  int wake_fd;
+  worker_pool pool;
+  /* Connections with responses to write, protected by queue_lock */
+  pthread_mutex_t queue_lock;
+  struct conn *queue;
+  struct conn *open;
+  struct conn *closed;
+  /* Set by server_stop, the loop exits once it sees it */
+  atomic_int stopping;
+  size_t accepted;
+  atomic_size_t served;
+} server;
+
+int server_init(server *s, llist *list, const char *path, size_t threads);
+void server_run(server *s);
+void server_stop(server *s);
+void server_shutdown(server *s);
+
+#endif
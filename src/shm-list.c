@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200809L
+#include "shm-list.h"
+#include "sync.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static shm_lnode *node_at(const shm_list *l, size_t offset) {
+  return (shm_lnode *)((char *)l->region + offset);
+}
+
+static size_t offset_of(const shm_list *l, const shm_lnode *node) {
+  return (size_t)((const char *)node - (const char *)l->region);
+}
+
+static shm_list *handle(shm_list_region *r, const char *name) {
+  shm_list *l = malloc(sizeof(*l));
+  l->region = r;
+  snprintf(l->name, sizeof(l->name), "%s", name);
+  return l;
+}
+
+/* Creates the segment name, which must not exist yet, holding an empty list
+of at most capacity nodes. Returns NULL on failure */
+shm_list *shm_list_create(const char *name, size_t capacity) {
+  if (strlen(name) >= SHM_LIST_NAME_MAX) {
+    fprintf(stderr, "List name too long: %s\n", name);
+    return NULL;
+  }
+  size_t size = sizeof(shm_list_region) + capacity * sizeof(shm_lnode);
+
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    perror("Couldn't create shared list");
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t)size) < 0) {
+    perror("Couldn't size shared list");
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  shm_list_region *r =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (r == MAP_FAILED) {
+    perror("Couldn't map shared list");
+    shm_unlink(name);
+    return NULL;
+  }
+
+  /* ftruncate zero-fills the segment, so the list starts out empty. As with
+  the metrics, the magic is written last so nobody attaches to a half
+  initialized list */
+  r->size = size;
+  r->capacity = capacity;
+  sem_new_shared(&r->no_searcher, 1);
+  sem_new_shared(&r->no_inserter, 1);
+  mutex_new_shared(&r->searcher_mutex);
+  atomic_thread_fence(memory_order_release);
+  r->magic = SHM_LIST_MAGIC;
+
+  return handle(r, name);
+}
+
+/* Maps the list created as name by any process, returns NULL if there is
+none */
+shm_list *shm_list_attach(const char *name) {
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(shm_list_region)) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = (size_t)st.st_size;
+  shm_list_region *r =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (r == MAP_FAILED) {
+    return NULL;
+  }
+  if (r->magic != SHM_LIST_MAGIC || r->size != size) {
+    munmap(r, size);
+    return NULL;
+  }
+  atomic_thread_fence(memory_order_acquire);
+
+  return handle(r, name);
+}
+
+/* Unmaps the list, which stays available to other processes */
+void shm_list_detach(shm_list *l) {
+  munmap(l->region, l->region->size);
+  free(l);
+}
+
+/* Removes the list, which no other process may be using anymore */
+void shm_list_destroy(shm_list *l) {
+  sem_destroy(&l->region->no_searcher);
+  sem_destroy(&l->region->no_inserter);
+  pthread_mutex_destroy(&l->region->searcher_mutex);
+  shm_unlink(l->name);
+  shm_list_detach(l);
+}
+
+/* Same protocol as llist_searcher_acquire and llist_searcher_release */
+static void searcher_acquire(shm_list_region *r) {
+  mutex_acquire(&r->searcher_mutex);
+  if (++r->searcher_count == 1) {
+    sem_acquire(&r->no_searcher);
+  }
+  mutex_release(&r->searcher_mutex);
+}
+
+static void searcher_release(shm_list_region *r) {
+  mutex_acquire(&r->searcher_mutex);
+  if (--r->searcher_count == 0) {
+    sem_release(&r->no_searcher);
+  }
+  mutex_release(&r->searcher_mutex);
+}
+
+/* Returns whether value is in the list */
+int shm_list_search(shm_list *l, size_t value) {
+  shm_list_region *r = l->region;
+  int found = 0;
+
+  searcher_acquire(r);
+  /* The inserter may be appending, it links nodes only once they're set */
+  size_t off = atomic_load_explicit(&r->head, memory_order_acquire);
+  while (off != 0 && !found) {
+    shm_lnode *node = node_at(l, off);
+    found = node->value == value;
+    off = atomic_load_explicit(&node->next, memory_order_acquire);
+  }
+  searcher_release(r);
+
+  return found;
+}
+
+/* Appends value to the list, returns -1 if every node is taken */
+int shm_list_insert(shm_list *l, size_t value) {
+  shm_list_region *r = l->region;
+  int ret = 0;
+
+  sem_acquire(&r->no_inserter);
+  shm_lnode *node = NULL;
+  if (r->free != 0) {
+    node = node_at(l, r->free);
+    r->free = atomic_load_explicit(&node->next, memory_order_relaxed);
+  } else if (r->used < r->capacity) {
+    node = &r->nodes[r->used++];
+  }
+
+  if (node == NULL) {
+    ret = -1;
+  } else {
+    node->value = value;
+    atomic_store_explicit(&node->next, 0, memory_order_relaxed);
+    atomic_size_t *link = &r->head;
+    size_t off;
+    while ((off = atomic_load_explicit(link, memory_order_relaxed)) != 0) {
+      link = &node_at(l, off)->next;
+    }
+    atomic_store_explicit(link, offset_of(l, node), memory_order_release);
+    atomic_fetch_add(&r->len, 1);
+  }
+  sem_release(&r->no_inserter);
+
+  return ret;
+}
+
+/* Removes the first node holding value, returns whether there was one */
+int shm_list_delete(shm_list *l, size_t value) {
+  shm_list_region *r = l->region;
+  int deleted = 0;
+
+  sem_acquire(&r->no_searcher);
+  sem_acquire(&r->no_inserter);
+  atomic_size_t *link = &r->head;
+  size_t off;
+  while ((off = atomic_load_explicit(link, memory_order_relaxed)) != 0) {
+    shm_lnode *node = node_at(l, off);
+    if (node->value == value) {
+      atomic_store_explicit(link, atomic_load(&node->next),
+                            memory_order_relaxed);
+      /* Nobody else holds the list, so the node can be reused right away */
+      atomic_store_explicit(&node->next, r->free, memory_order_relaxed);
+      r->free = off;
+      atomic_fetch_sub(&r->len, 1);
+      deleted = 1;
+      break;
+    }
+    link = &node->next;
+  }
+  sem_release(&r->no_inserter);
+  sem_release(&r->no_searcher);
+
+  return deleted;
+}
+
+size_t shm_list_len(const shm_list *l) { return atomic_load(&l->region->len); }
+
+/* Prints the values in the list, holding it as a searcher */
+void shm_list_print(shm_list *l) {
+  shm_list_region *r = l->region;
+
+  searcher_acquire(r);
+  size_t off = atomic_load_explicit(&r->head, memory_order_acquire);
+  while (off != 0) {
+    shm_lnode *node = node_at(l, off);
+    off = atomic_load_explicit(&node->next, memory_order_acquire);
+    printf("%zu", node->value);
+    if (off != 0) {
+      printf(" -> ");
+    }
+  }
+  printf("\n");
+  searcher_release(r);
+}
@@ -0,0 +1,69 @@
+#ifndef _SHM_LIST_INCLUDE_H
+#define _SHM_LIST_INCLUDE_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHM_LIST_MAGIC 0x3154534c34303543ull /* "C504LST1" */
+#define SHM_LIST_NAME_MAX 64
+
+/*
+A list shared by several processes, all of which can be searchers, inserters
+and deleters on it with the same rules as in llist: searchers run together,
+along with at most one inserter, and a deleter runs alone.
+
+The list, its nodes and its semaphores live in a POSIX shared-memory segment
+which every process maps wherever it wants, so nodes link to each other by
+their offset from the start of the segment instead of by pointer, and offset 0,
+which is the header, stands for NULL. Nodes are allocated from a fixed pool
+sized when the list is created. Deleted nodes go to a free list which inserters
+take from before the never used ones, both of them are protected by
+no_inserter, which inserters and deleters hold.
+
+The semaphores and the mutex are process-shared, so they're only valid in the
+segment and must not be copied out of it. A process which dies while holding
+the list leaves it held.
+*/
+typedef struct {
+  atomic_size_t next;
+  size_t value;
+} shm_lnode;
+
+typedef struct shm_list_region {
+  uint64_t magic;
+  /* Bytes in the segment and nodes in the pool */
+  size_t size;
+  size_t capacity;
+  atomic_size_t head;
+  size_t free;
+  /* Nodes of the pool ever handed out */
+  size_t used;
+  atomic_size_t len;
+  sem_t no_searcher;
+  sem_t no_inserter;
+  pthread_mutex_t searcher_mutex;
+  int searcher_count;
+  _Alignas(max_align_t) shm_lnode nodes[];
+} shm_list_region;
+
+/* A process' mapping of a shared list */
+typedef struct {
+  shm_list_region *region;
+  char name[SHM_LIST_NAME_MAX];
+} shm_list;
+
+shm_list *shm_list_create(const char *name, size_t capacity);
+shm_list *shm_list_attach(const char *name);
+void shm_list_detach(shm_list *l);
+void shm_list_destroy(shm_list *l);
+
+int shm_list_search(shm_list *l, size_t value);
+int shm_list_insert(shm_list *l, size_t value);
+int shm_list_delete(shm_list *l, size_t value);
+size_t shm_list_len(const shm_list *l);
+void shm_list_print(shm_list *l);
+
+#endif
@@ -0,0 +1,110 @@
+#include "slots.h"
+#include "sync.h"
+#include <stdlib.h>
+
+/* Finds the segment and offset of the slot with the given handle */
+static slot *slot_at(slot_registry *reg, size_t handle) {
+  size_t k = 0;
+  size_t size = SLOTS_FIRST_SEGMENT;
+
+  while (handle >= size) {
+    handle -= size;
+    size <<= 1;
+    k++;
+  }
+
+  slot *segment = atomic_load_explicit(&reg->segments[k], memory_order_acquire);
+  return &segment[handle];
+}
+
+void slots_init(slot_registry *reg) {
+  for (size_t k = 0; k < SLOTS_SEGMENTS; k++) {
+    atomic_init(&reg->segments[k], NULL);
+  }
+  atomic_init(&reg->high, 0);
+  atomic_init(&reg->len, 0);
+  reg->free = SLOTS_NONE;
+  mutex_new(&reg->lock);
+}
+
+void slots_destroy(slot_registry *reg) {
+  for (size_t k = 0; k < SLOTS_SEGMENTS; k++) {
+    free(atomic_load(&reg->segments[k]));
+  }
+  pthread_mutex_destroy(&reg->lock);
+}
+
+/* Stores value in a free slot and returns its handle */
+size_t slots_acquire(slot_registry *reg, size_t value) {
+  size_t handle;
+
+  mutex_acquire(&reg->lock);
+  if (reg->free != SLOTS_NONE) {
+    handle = reg->free;
+    reg->free = slot_at(reg, handle)->next_free;
+  } else {
+    handle = atomic_load_explicit(&reg->high, memory_order_relaxed);
+
+    /* Allocate the next segment when the handle falls right at its start */
+    size_t k = 0;
+    size_t start = 0;
+    size_t size = SLOTS_FIRST_SEGMENT;
+    while (start + size <= handle) {
+      start += size;
+      size <<= 1;
+      k++;
+    }
+    if (handle == start &&
+        atomic_load_explicit(&reg->segments[k], memory_order_relaxed) == NULL) {
+      slot *segment = calloc(size, sizeof(*segment));
+      atomic_store_explicit(&reg->segments[k], segment, memory_order_release);
+    }
+
+    atomic_store_explicit(&reg->high, handle + 1, memory_order_release);
+  }
+  mutex_release(&reg->lock);
+
+  atomic_store_explicit(&slot_at(reg, handle)->value, value,
+                        memory_order_release);
+  atomic_fetch_add_explicit(&reg->len, 1, memory_order_relaxed);
+
+  return handle;
+}
+
+void slots_release(slot_registry *reg, size_t handle) {
+  slot *s = slot_at(reg, handle);
+  atomic_store_explicit(&s->value, 0, memory_order_release);
+  atomic_fetch_sub_explicit(&reg->len, 1, memory_order_relaxed);
+
+  mutex_acquire(&reg->lock);
+  s->next_free = reg->free;
+  reg->free = handle;
+  mutex_release(&reg->lock);
+}
+
+size_t slots_len(slot_registry *reg) {
+  return atomic_load_explicit(&reg->len, memory_order_relaxed);
+}
+
+/* Calls f with every value currently in the registry, without blocking
+acquire or release */
+void slots_foreach(slot_registry *reg, void (*f)(size_t value, void *arg),
+                   void *arg) {
+  size_t high = atomic_load_explicit(&reg->high, memory_order_acquire);
+  size_t start = 0;
+  size_t size = SLOTS_FIRST_SEGMENT;
+
+  for (size_t k = 0; k < SLOTS_SEGMENTS && start < high; k++) {
+    slot *segment =
+        atomic_load_explicit(&reg->segments[k], memory_order_acquire);
+    for (size_t i = 0; i < size && start + i < high; i++) {
+      size_t value =
+          atomic_load_explicit(&segment[i].value, memory_order_acquire);
+      if (value != 0) {
+        f(value, arg);
+      }
+    }
+    start += size;
+    size <<= 1;
+  }
+}
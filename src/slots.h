@@ -0,0 +1,52 @@
+#ifndef _SLOTS_INCLUDE_H
+#define _SLOTS_INCLUDE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/* Segment k holds SLOTS_FIRST_SEGMENT << k slots, so 48 segments are more than
+enough to never run out */
+#define SLOTS_FIRST_SEGMENT 64
+#define SLOTS_SEGMENTS 48
+
+typedef struct {
+  /* 0 means the slot is free */
+  atomic_size_t value;
+  /* Next free slot, only valid while the slot is in the free list */
+  size_t next_free;
+} slot;
+
+/*
+Registry of values being processed by the active searchers.
+
+Each searcher takes a slot (its handle) when it enters and gives it back when
+it leaves, both in O(1). Slots live in segments which are allocated as the
+registry grows but never moved, so there is no size limit and readers can walk
+the registry with slots_foreach without taking any lock, at the cost of
+possibly seeing a slot that is being taken or given back concurrently.
+
+Values must be non-zero since 0 marks a free slot.
+*/
+typedef struct {
+  _Atomic(slot *) segments[SLOTS_SEGMENTS];
+  /* Number of slots that have ever been handed out */
+  atomic_size_t high;
+  /* Number of slots currently taken */
+  atomic_size_t len;
+  /* Head of the free list, SLOTS_NONE if empty */
+  size_t free;
+  pthread_mutex_t lock;
+} slot_registry;
+
+#define SLOTS_NONE ((size_t)-1)
+
+void slots_init(slot_registry *reg);
+void slots_destroy(slot_registry *reg);
+size_t slots_acquire(slot_registry *reg, size_t value);
+void slots_release(slot_registry *reg, size_t handle);
+size_t slots_len(slot_registry *reg);
+void slots_foreach(slot_registry *reg, void (*f)(size_t value, void *arg),
+                   void *arg);
+
+#endif
@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdio.h>
@@ -11,6 +12,19 @@ pthread_mutex_t *mutex_new(pthread_mutex_t *mutex) {
   return mutex;
 }
 
+/* Same as mutex_new, for a mutex in memory shared between processes */
+pthread_mutex_t *mutex_new_shared(pthread_mutex_t *mutex) {
+  pthread_mutexattr_t attr;
+  if (pthread_mutexattr_init(&attr) != 0 ||
+      pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0 ||
+      pthread_mutex_init(mutex, &attr) != 0) {
+    perror("Couldn't initialize process-shared mutex");
+    exit(1);
+  }
+  pthread_mutexattr_destroy(&attr);
+  return mutex;
+}
+
 void mutex_acquire(pthread_mutex_t *mutex) {
   if (pthread_mutex_lock(mutex) < 0) {
     perror("Failed to lock mutex");
@@ -33,11 +47,23 @@ sem_t *sem_new(sem_t *sem, unsigned int value) {
   return sem;
 }
 
-void sem_acquire(sem_t *sem) {
-  if (sem_wait(sem) < 0) {
-    perror("Failed to lock semaphore");
+/* Same as sem_new, for a semaphore in memory shared between processes */
+sem_t *sem_new_shared(sem_t *sem, unsigned int value) {
+  if (sem_init(sem, 1, value) < 0) {
+    perror("Couldn't initialize process-shared semaphore");
     exit(1);
   }
+  return sem;
+}
+
+/* Retries if interrupted by a signal handler, e.g. the one stopping a run */
+void sem_acquire(sem_t *sem) {
+  while (sem_wait(sem) < 0) {
+    if (errno != EINTR) {
+      perror("Failed to lock semaphore");
+      exit(1);
+    }
+  }
 }
 
 void sem_release(sem_t *sem) {
@@ -46,3 +72,39 @@ void sem_release(sem_t *sem) {
     exit(1);
   }
 }
+
+/* Returns 0 if the semaphore was acquired and -1 if it would block */
+int sem_try_acquire(sem_t *sem) {
+  while (sem_trywait(sem) < 0) {
+    if (errno == EAGAIN) {
+      return -1;
+    }
+    if (errno != EINTR) {
+      perror("Failed to lock semaphore");
+      exit(1);
+    }
+  }
+  return 0;
+}
+
+pthread_cond_t *cond_new(pthread_cond_t *cond) {
+  if (pthread_cond_init(cond, NULL) != 0) {
+    perror("Couldn't initialize condition variable");
+    exit(1);
+  }
+  return cond;
+}
+
+void cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+  if (pthread_cond_wait(cond, mutex) != 0) {
+    perror("Failed to wait on condition variable");
+    exit(1);
+  }
+}
+
+void cond_broadcast(pthread_cond_t *cond) {
+  if (pthread_cond_broadcast(cond) != 0) {
+    perror("Failed to broadcast condition variable");
+    exit(1);
+  }
+}
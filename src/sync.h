@@ -8,6 +8,7 @@
 on failure */
 
 pthread_mutex_t* mutex_new(pthread_mutex_t* mutex);
+pthread_mutex_t *mutex_new_shared(pthread_mutex_t *mutex);
 void mutex_acquire(pthread_mutex_t* mutex);
 void mutex_release(pthread_mutex_t *mutex);
 
@@ -15,7 +16,16 @@ void mutex_release(pthread_mutex_t *mutex);
 failure */
 
 sem_t* sem_new(sem_t* sem, int value);
+sem_t *sem_new_shared(sem_t *sem, unsigned int value);
 void sem_acquire(sem_t *sem);
 void sem_release(sem_t *sem);
+int sem_try_acquire(sem_t *sem);
+
+/* Wrappers around pthread_cond_* functions that prints to stderr and calls exit
+on failure */
+
+pthread_cond_t *cond_new(pthread_cond_t *cond);
+void cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+void cond_broadcast(pthread_cond_t *cond);
 
 #endif
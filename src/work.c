@@ -0,0 +1,89 @@
+#define _POSIX_C_SOURCE 200809L
+#include "work.h"
+#include "clock.h"
+#include "rng.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void spin(uint64_t ns) {
+  uint64_t deadline = clock_ns() + ns;
+  while (clock_ns() < deadline) {
+  }
+}
+
+void work_run(const work_model *model) {
+  switch (model->kind) {
+  case WORK_NONE:
+    break;
+  case WORK_SPIN:
+    spin(model->ns);
+    break;
+  case WORK_SLEEP: {
+    struct timespec ts = {.tv_sec = (time_t)(model->ns / 1000000000u),
+                          .tv_nsec = (long)(model->ns % 1000000000u)};
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+    break;
+  }
+  case WORK_EXPONENTIAL:
+    spin((uint64_t)(-log(1.0 - rng_unit(rng_local())) * (double)model->ns));
+    break;
+  case WORK_UNIFORM:
+    spin(rng_below(rng_local(), model->ns + 1));
+    break;
+  }
+}
+
+/*
+Parses a work model from spec, which is one of:
+
+- none
+- spin:N     busy-spin for N nanoseconds
+- sleep:N    sleep for N microseconds
+- exp:N      busy-spin for an exponential duration with mean N nanoseconds
+- uniform:N  busy-spin for a uniform duration in [0, N] nanoseconds
+
+Returns 0 on success and -1 if spec is invalid, in which case model is left
+untouched.
+*/
+int work_parse(const char *spec, work_model *model) {
+  static const struct {
+    const char *name;
+    work_kind kind;
+    uint64_t scale;
+  } kinds[] = {
+      {"spin", WORK_SPIN, 1},
+      {"sleep", WORK_SLEEP, 1000},
+      {"exp", WORK_EXPONENTIAL, 1},
+      {"uniform", WORK_UNIFORM, 1},
+  };
+
+  if (strcmp(spec, "none") == 0) {
+    *model = (work_model){.kind = WORK_NONE, .ns = 0};
+    return 0;
+  }
+
+  const char *colon = strchr(spec, ':');
+  if (colon == NULL || colon[1] == '\0') {
+    return -1;
+  }
+
+  for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+    size_t len = strlen(kinds[i].name);
+    if ((size_t)(colon - spec) != len || strncmp(spec, kinds[i].name, len)) {
+      continue;
+    }
+    char *end;
+    unsigned long long n = strtoull(colon + 1, &end, 10);
+    if (*end != '\0') {
+      return -1;
+    }
+    *model = (work_model){.kind = kinds[i].kind,
+                          .ns = (uint64_t)n * kinds[i].scale};
+    return 0;
+  }
+
+  return -1;
+}
@@ -0,0 +1,36 @@
+#ifndef _WORK_INCLUDE_H
+#define _WORK_INCLUDE_H
+
+#include <stdint.h>
+
+/*
+Simulated work done by a worker inside its critical section, before it
+operates on the list:
+
+- WORK_NONE: Operate on the list right away, which measures the real cost of
+  the data structure
+- WORK_SPIN: Busy-spin for ns nanoseconds
+- WORK_SLEEP: Sleep for ns nanoseconds, handy for watching the demo
+- WORK_EXPONENTIAL: Busy-spin for an exponentially distributed duration with
+  mean ns
+- WORK_UNIFORM: Busy-spin for a duration drawn uniformly from [0, ns]
+
+A zero-initialized work_model does no work.
+*/
+typedef enum {
+  WORK_NONE,
+  WORK_SPIN,
+  WORK_SLEEP,
+  WORK_EXPONENTIAL,
+  WORK_UNIFORM,
+} work_kind;
+
+typedef struct {
+  work_kind kind;
+  uint64_t ns;
+} work_model;
+
+void work_run(const work_model *model);
+int work_parse(const char *spec, work_model *model);
+
+#endif
@@ -1,29 +1,128 @@
-#include "int-list.h"
+#include "chrome-trace.h"
+#include "clock.h"
+#include "events.h"
+#include "executor.h"
+#include "keyspace.h"
+#include "metrics.h"
+#include "search-batch.h"
 #include "sync.h"
 #include "workers.h"
 #include <assert.h>
-#include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
-
-void state_print(llist *list) {
-  state *s = &list->st;
-  printf("__________________________________________________\n");
-  llist_print(list);
-  printf("STATUS:\n");
-  for (size_t i = 0; i < s->searchers.size; i++) {
-    printf("    Searching for %ld\n", s->searchers.items[i]);
+
+/* Appends an event to the list's event log, if there is one. It takes no lock,
+but if the ring is full the caller waits for the consumer to make room, still
+holding whatever semaphores of the list it holds */
+static void emit(llist *list, event_kind kind, worker_role role, size_t value,
+                 int result, size_t slot) {
+  if (list->st.log == NULL) {
+    return;
+  }
+  event ev = {.kind = kind,
+              .role = role,
+              .result = result,
+              .value = value,
+              .slot = slot};
+  event_log_push(list->st.log, &ev);
+}
+
+/* Counts the worker as waiting in the list's metrics, if there are any, and
+returns when it started waiting */
+static uint64_t wait_begin(llist *list, worker_role role) {
+  if (list->st.metrics == NULL) {
+    return 0;
+  }
+  metrics_waiting(list->st.metrics, role, 1);
+  return clock_ns();
+}
+
+/* Counts the worker as no longer waiting, adding the time it was blocked to
+the lock wait total */
+static void wait_end(llist *list, worker_role role, uint64_t start) {
+  metrics *m = list->st.metrics;
+  if (m == NULL) {
+    return;
+  }
+  metrics_lock_wait(m, role, clock_ns() - start);
+  metrics_waiting(m, role, -1);
+  if (role == ROLE_SEARCHER) {
+    metrics_add(&m->searchers_active, 1);
+  }
+}
+
+/* Tells the list's executor, if any, that the list was released so it resumes
+the operations waiting for it */
+static void wake(llist *list, unsigned who) {
+  if (list->st.executor != NULL) {
+    executor_wake(list->st.executor, who);
+  }
+}
+
+/* Roles of the waiting interactive operations that a background operation of
+each role would delay, i.e. the roles it excludes */
+static const unsigned excludes[3] = {
+    [ROLE_SEARCHER] = WAKE_DELETER,
+    [ROLE_INSERTER] = WAKE_INSERTER | WAKE_DELETER,
+    [ROLE_DELETER] = WAKE_SEARCHERS | WAKE_INSERTER | WAKE_DELETER,
+};
+
+/* Whether an interactive operation that role would delay is waiting */
+static int interactive_ahead(llist *list, worker_role role) {
+  for (int r = 0; r < 3; r++) {
+    if ((excludes[role] & (1u << r)) &&
+        atomic_load(&list->st.interactive_waiting[r]) > 0) {
+      return 1;
+    }
   }
-  if (s->inserters != 0) {
-    printf("    Inserting %ld\n", s->inserters);
+  return 0;
+}
+
+/* Called before an operation starts waiting for the list. Interactive
+operations announce themselves, while background ones first wait until they
+wouldn't delay any of them, so they never get ahead in the semaphores' queues.
+Background operations can starve under a steady stream of interactive ones */
+static void priority_enter(llist *list, const llist_ctx *ctx,
+                           worker_role role) {
+  if (ctx->priority == PRIORITY_INTERACTIVE) {
+    atomic_fetch_add(&list->st.interactive_waiting[role], 1);
+    return;
+  }
+  if (!interactive_ahead(list, role)) {
+    return;
+  }
+  mutex_acquire(&list->st.lock);
+  while (interactive_ahead(list, role)) {
+    cond_wait(&list->st.interactive_left, &list->st.lock);
+  }
+  mutex_release(&list->st.lock);
+}
+
+/* Called once an operation acquired the list, lets the background operations
+in once the last interactive one of its role is in */
+static void priority_leave(llist *list, const llist_ctx *ctx,
+                           worker_role role) {
+  if (ctx->priority != PRIORITY_INTERACTIVE ||
+      atomic_fetch_sub(&list->st.interactive_waiting[role], 1) != 1) {
+    return;
+  }
+  mutex_acquire(&list->st.lock);
+  cond_broadcast(&list->st.interactive_left);
+  mutex_release(&list->st.lock);
+  wake(list, WAKE_SEARCHERS | WAKE_INSERTER | WAKE_DELETER);
+}
+
+/* Records that a worker finished its operation, len is the list's length
+before it. Writers still hold the list, so the change they add to the run's
+total length is only theirs */
+static void completed(llist *list, worker_role role, size_t len) {
+  metrics *m = list->st.metrics;
+  if (m == NULL) {
+    return;
   }
-  if (s->deleters != 0) {
-    printf("    Deleting %ld\n", s->deleters);
+  metrics_completed(m, role);
+  if (role != ROLE_SEARCHER) {
+    metrics_add(&m->list_len, (int64_t)atomic_load(&list->len) - (int64_t)len);
   }
-  printf("WAITING QUEUE:\n");
-  printf("    Searchers waiting: %d\n    Inserters waiting: %d\n    Deleters "
-         "waiting: %d\n",
-         s->searchers_waiting, s->inserters_waiting, s->deleters_waiting);
 }
 
 int llist_searcher_acquire(llist_ctx *list_ctx) {
@@ -36,10 +135,10 @@ int llist_searcher_acquire(llist_ctx *list_ctx) {
   to acquire this semaphore only when searcher_count == 1.
   */
   llist *list = list_ctx->list;
-  mutex_acquire(&list->st.lock);
   list->st.searchers_waiting++;
-  state_print(list);
-  mutex_release(&list->st.lock);
+  emit(list, EVENT_WAIT, ROLE_SEARCHER, list_ctx->value, 0, 0);
+  uint64_t start = wait_begin(list, ROLE_SEARCHER);
+  priority_enter(list, list_ctx, ROLE_SEARCHER);
 
   /* Lock the mutex to update searcher count */
   mutex_acquire(&list->searcher_mutex);
@@ -52,19 +151,19 @@ int llist_searcher_acquire(llist_ctx *list_ctx) {
   }
 
   /* We only check this *after* we've locked the no_searcher semaphore */
-  mutex_acquire(&list->st.lock);
   list->st.searchers_waiting--;
-  /* Now we can add to the end of the searchers list the new value */
-  int_list_append(&list->st.searchers, list_ctx->value);
+  /* Now we can register the value being searched, this doesn't need st.lock */
+  list_ctx->slot = slots_acquire(&list->st.searchers, list_ctx->value);
+  wait_end(list, ROLE_SEARCHER, start);
   /* Searchers cannot run concurrently with deleters */
   // assert(list->st.deleters == -1);
   /* At most one inserter can be active at a time */
   // assert(list->st.inserters <= 1);
-  state_print(list);
-  mutex_release(&list->st.lock);
+  emit(list, EVENT_ENTER, ROLE_SEARCHER, list_ctx->value, 0, list_ctx->slot);
 
   /* Unlock the mutex so other searchers can enter */
   mutex_release(&list->searcher_mutex);
+  priority_leave(list, list_ctx, ROLE_SEARCHER);
 
   return 0;
 }
@@ -83,19 +182,26 @@ int llist_searcher_release(llist_ctx *list_ctx) {
 
   list->searcher_count--;
 
-  mutex_acquire(&list->st.lock);
-  /* Remove the value from the searchers list */
-  int_list_remove(&list->st.searchers, list_ctx->value);
-  mutex_release(&list->st.lock);
+  /* Give back the searcher's slot */
+  slots_release(&list->st.searchers, list_ctx->slot);
+  if (list->st.metrics != NULL) {
+    metrics_add(&list->st.metrics->searchers_active, -1);
+  }
+  emit(list, EVENT_LEAVE, ROLE_SEARCHER, list_ctx->value, 0, list_ctx->slot);
 
   /* Only the last searcher unlocks the no_searcher semaphore */
-  if (list->searcher_count == 0) {
+  int last = list->searcher_count == 0;
+  if (last) {
     sem_release(&list->no_searcher);
   }
 
   /* Unlock the mutex so other searchers can enter */
   mutex_release(&list->searcher_mutex);
 
+  if (last) {
+    wake(list, WAKE_SEARCHERS | WAKE_DELETER);
+  }
+
   return 0;
 }
 
@@ -107,25 +213,27 @@ int llist_inserter_acquire(llist_ctx *list_ctx) {
   */
   llist *list = list_ctx->list;
 
-  mutex_acquire(&list->st.lock);
   list->st.inserters_waiting++;
-  state_print(list);
-  mutex_release(&list->st.lock);
+  emit(list, EVENT_WAIT, ROLE_INSERTER, list_ctx->value, 0, 0);
+  uint64_t start = wait_begin(list, ROLE_INSERTER);
+  priority_enter(list, list_ctx, ROLE_INSERTER);
 
   /* Since the deleter holds the no_inserter semaphore while it's active, we can
   use it as a way to find out if there is a deleter active */
   sem_acquire(&list->no_inserter);
+  wait_end(list, ROLE_INSERTER, start);
+  priority_leave(list, list_ctx, ROLE_INSERTER);
 
   mutex_acquire(&list->st.lock);
   list->st.inserters = list_ctx->value;
   list->st.inserters_waiting--;
-  state_print(list);
   /* At most one inserter can be active at a time */
   // assert(list->st.inserters <= 1);
   /* Inserters and deleters cannot run concurrently */
   // assert(list->st.deleters == 0);
 
   mutex_release(&list->st.lock);
+  emit(list, EVENT_ENTER, ROLE_INSERTER, list_ctx->value, 0, 0);
 
   return 0;
 }
@@ -143,11 +251,14 @@ int llist_inserter_release(llist *list) {
   /* Inserters may not run concurrently with other deleters */
   // assert(list->st.deleters == -1);
 
+  size_t value = list->st.inserters;
   list->st.inserters = 0;
   mutex_release(&list->st.lock);
+  emit(list, EVENT_LEAVE, ROLE_INSERTER, value, 0, 0);
 
   /* Signal that there are currently no inserters */
   sem_release(&list->no_inserter);
+  wake(list, WAKE_INSERTER | WAKE_DELETER);
 
   return 0;
 }
@@ -161,14 +272,16 @@ int llist_deleter_acquire(llist_ctx *list_ctx) {
   */
   llist *list = list_ctx->list;
 
-  mutex_acquire(&list->st.lock);
   list->st.deleters_waiting++;
-  state_print(list);
-  mutex_release(&list->st.lock);
+  emit(list, EVENT_WAIT, ROLE_DELETER, list_ctx->value, 0, 0);
+  uint64_t start = wait_begin(list, ROLE_DELETER);
+  priority_enter(list, list_ctx, ROLE_DELETER);
 
   /* Wait until there are no searchers/inserters */
   sem_acquire(&list->no_searcher);
   sem_acquire(&list->no_inserter);
+  wait_end(list, ROLE_DELETER, start);
+  priority_leave(list, list_ctx, ROLE_DELETER);
 
   mutex_acquire(&list->st.lock);
   list->st.deleters_waiting--;
@@ -177,8 +290,8 @@ int llist_deleter_acquire(llist_ctx *list_ctx) {
   /* Deleters cannot run concurrently with deleters, inserters or searchers */
   // assert(list->st.deleters == -1);
   // assert(list->st.inserters == 0);
-  state_print(list);
   mutex_release(&list->st.lock);
+  emit(list, EVENT_ENTER, ROLE_DELETER, list_ctx->value, 0, 0);
 
   return 0;
 }
@@ -191,6 +304,7 @@ int llist_deleter_release(llist *list) {
   */
 
   mutex_acquire(&list->st.lock);
+  size_t value = list->st.deleters;
   list->st.deleters = 0;
 
   /* Deleters cannot run concurrently with deleters, inserters or searchers */
@@ -198,48 +312,180 @@ int llist_deleter_release(llist *list) {
   // assert(list->st.inserters == -1);
 
   mutex_release(&list->st.lock);
+  emit(list, EVENT_LEAVE, ROLE_DELETER, value, 0, 0);
 
   /* Drop no_inserter and no_searchers semaphores */
   sem_release(&list->no_inserter);
   sem_release(&list->no_searcher);
+  wake(list, WAKE_SEARCHERS | WAKE_INSERTER | WAKE_DELETER);
   return 0;
 }
 
-/* TODO: What can we return?
+/*
+Non-blocking versions of the acquire functions, used by coroutines. They return
+0 once the list is acquired, with the same bookkeeping as the blocking ones,
+and -1 if the caller must wait until the list is released and try again. The
+operation must have been announced as waiting by llist_op_step.
+*/
+
+int llist_searcher_try_acquire(llist_op *op) {
+  llist_ctx *ctx = &op->ctx;
+  llist *list = ctx->list;
+
+  mutex_acquire(&list->searcher_mutex);
+  /* Same as in llist_searcher_acquire, but the first searcher gives up instead
+  of waiting for a deleter to leave */
+  if (list->searcher_count == 0 && sem_try_acquire(&list->no_searcher) < 0) {
+    mutex_release(&list->searcher_mutex);
+    return -1;
+  }
+  list->searcher_count++;
+
+  list->st.searchers_waiting--;
+  ctx->slot = slots_acquire(&list->st.searchers, ctx->value);
+  wait_end(list, ROLE_SEARCHER, op->wait_start);
+  emit(list, EVENT_ENTER, ROLE_SEARCHER, ctx->value, 0, ctx->slot);
+  mutex_release(&list->searcher_mutex);
+
+  return 0;
+}
+
+int llist_inserter_try_acquire(llist_op *op) {
+  llist_ctx *ctx = &op->ctx;
+  llist *list = ctx->list;
+
+  if (sem_try_acquire(&list->no_inserter) < 0) {
+    return -1;
+  }
+  wait_end(list, ROLE_INSERTER, op->wait_start);
+
+  mutex_acquire(&list->st.lock);
+  list->st.inserters = ctx->value;
+  list->st.inserters_waiting--;
+  mutex_release(&list->st.lock);
+  emit(list, EVENT_ENTER, ROLE_INSERTER, ctx->value, 0, 0);
+
+  return 0;
+}
+
+int llist_deleter_try_acquire(llist_op *op) {
+  llist_ctx *ctx = &op->ctx;
+  llist *list = ctx->list;
+
+  if (sem_try_acquire(&list->no_searcher) < 0) {
+    return -1;
+  }
+  if (sem_try_acquire(&list->no_inserter) < 0) {
+    /* Don't hold no_searcher while waiting, searchers that tried in the
+    meantime have to be resumed. Other deleters don't, this one will wake them
+    when it's done */
+    sem_release(&list->no_searcher);
+    wake(list, WAKE_SEARCHERS);
+    return -1;
+  }
+  wait_end(list, ROLE_DELETER, op->wait_start);
+
+  mutex_acquire(&list->st.lock);
+  list->st.deleters_waiting--;
+  list->st.deleters = ctx->value;
+  mutex_release(&list->st.lock);
+  emit(list, EVENT_ENTER, ROLE_DELETER, ctx->value, 0, 0);
+
+  return 0;
+}
+
+/* Returns a pointer to 1 if the value was deleted and to 0 otherwise, these are
+static so the caller never has to free them */
+static int deleted = 1;
+static int not_deleted = 0;
+
+/*
+Everything an operation does once it holds the list: the simulated work, the
+operation itself and the release. Shared by the thread functions and the
+coroutines, returns what the thread function returns.
+
+TODO: What can searchers return?
 - Value: Redundant information since the caller already provides the value
 - Int: 0 for found, -1 not found, gives little information
 - Pointer to value: Good information, but can be invalidated by deleting it from
 the list which can risk use-after-free or double-free
 */
+static void *operate(llist_ctx *ctx, worker_role role) {
+  void *found = NULL;
+  int result = 1;
+  size_t len = atomic_load(&ctx->list->len);
+
+  ctrace_begin("critical section", role, ctx->value);
+  work_run(&ctx->work);
+  switch (role) {
+  case ROLE_SEARCHER:
+    found = ctx->list->st.batch != NULL
+                ? search_batch_find(ctx->list->st.batch, ctx->list, ctx->value)
+                : llist_find(ctx->list, ctx->value);
+    result = found != NULL;
+    break;
+  case ROLE_INSERTER:
+    llist_push_back_kv(ctx->list, ctx->value, ctx->payload);
+    break;
+  case ROLE_DELETER:
+    /* Deleters hold the list exclusively, so they reorganize it for the
+    searches that ran before them */
+    llist_maintain(ctx->list);
+    // TODO what happens when we can't delete?
+    result = llist_delete(ctx->list, ctx->value);
+    break;
+  }
+  ctrace_end("critical section", role, ctx->value);
+
+  ctrace_begin("result", role, ctx->value);
+  completed(ctx->list, role, len);
+  emit(ctx->list, EVENT_RESULT, role, ctx->value, result,
+       role == ROLE_SEARCHER ? ctx->slot : 0);
+
+  switch (role) {
+  case ROLE_SEARCHER:
+    llist_searcher_release(ctx);
+    break;
+  case ROLE_INSERTER:
+    llist_inserter_release(ctx->list);
+    break;
+  case ROLE_DELETER:
+    llist_deleter_release(ctx->list);
+    break;
+  }
+  ctrace_end("result", role, ctx->value);
+
+  if (role == ROLE_SEARCHER) {
+    return found;
+  }
+  if (role == ROLE_DELETER) {
+    return result ? &deleted : &not_deleted;
+  }
+  return NULL;
+}
+
+/* Looks up the list of an operation addressed by id, if it wasn't already.
+This is a single load, the keyspace takes no lock */
+void llist_ctx_resolve(llist_ctx *ctx) {
+  if (ctx->list == NULL && ctx->keyspace != NULL) {
+    ctx->list = keyspace_list(ctx->keyspace, ctx->list_id);
+  }
+}
+
 void *searcher_thread(void *args) {
   /*
   Firstly, we acquire the necessary semaphores to properly run
   the searcher thread and tries to find the given value.
   */
   llist_ctx ctx = *(llist_ctx *)args;
+  llist_ctx_resolve(&ctx);
 
+  ctrace_begin("wait", ROLE_SEARCHER, ctx.value);
   llist_searcher_acquire(&ctx);
+  ctrace_end("wait", ROLE_SEARCHER, ctx.value);
 
   // Here, I am sure the searcher thread is running
-  // Print the state showing that the searcher is currently searching for
-  // ctx->value
-
-  sleep(3);
-  void *result = llist_find(ctx.list, ctx.value);
-
-  mutex_acquire(&ctx.list->st.lock);
-  state_print(ctx.list);
-  printf("RESULT:\n");
-  if (result == NULL) {
-    printf("    The value %ld is not on the list.\n", ctx.value);
-  } else {
-    printf("    The value %ld was found on the list!\n", ctx.value);
-  }
-  mutex_release(&ctx.list->st.lock);
-
-  llist_searcher_release(&ctx);
-
-  return result;
+  return operate(&ctx, ROLE_SEARCHER);
 }
 
 /* TODO: What can we return?
@@ -249,46 +495,70 @@ void *searcher_thread(void *args) {
 */
 void *inserter_thread(void *args) {
   llist_ctx ctx = *(llist_ctx *)args;
+  llist_ctx_resolve(&ctx);
 
+  ctrace_begin("wait", ROLE_INSERTER, ctx.value);
   llist_inserter_acquire(&ctx);
+  ctrace_end("wait", ROLE_INSERTER, ctx.value);
 
-  sleep(3);
-  llist_push_back(ctx.list, ctx.value);
-
-  mutex_acquire(&ctx.list->st.lock);
-  state_print(ctx.list);
-  printf("RESULT:\n");
-  printf("    The value %ld was inserted!\n", ctx.value);
-  mutex_release(&ctx.list->st.lock);
-
-  llist_inserter_release(ctx.list);
-
-  return NULL;
+  return operate(&ctx, ROLE_INSERTER);
 }
 
-/* TODO: What can we return?
- */
 void *deleter_thread(void *args) {
   llist_ctx ctx = *(llist_ctx *)args;
+  llist_ctx_resolve(&ctx);
 
+  ctrace_begin("wait", ROLE_DELETER, ctx.value);
   llist_deleter_acquire(&ctx);
+  ctrace_end("wait", ROLE_DELETER, ctx.value);
 
-  // TODO what happens when we can't delete?
-  sleep(3);
-  int result = llist_delete(ctx.list, ctx.value);
-
-  mutex_acquire(&ctx.list->st.lock);
-  state_print(ctx.list);
-  printf("RESULT:\n");
-  if (result == 0) {
-    printf("    The value %ld was not deleted because it is not in the list!\n",
-           ctx.value);
-  } else {
-    printf("    The value %ld was deleted!\n", ctx.value);
-  }
-  mutex_release(&ctx.list->st.lock);
+  return operate(&ctx, ROLE_DELETER);
+}
 
-  llist_deleter_release(ctx.list);
+/* Resumes op, returns 1 once it's done and 0 if it's waiting for the list to
+be released, in which case it must be stepped again after that */
+int llist_op_step(llist_op *op) {
+  llist_ctx_resolve(&op->ctx);
+  llist *list = op->ctx.list;
+  int (*try_acquire[3])(llist_op *) = {llist_searcher_try_acquire,
+                                       llist_inserter_try_acquire,
+                                       llist_deleter_try_acquire};
+
+  switch (op->state) {
+  case OP_START:
+    if (op->role == ROLE_SEARCHER) {
+      list->st.searchers_waiting++;
+    } else if (op->role == ROLE_INSERTER) {
+      list->st.inserters_waiting++;
+    } else {
+      list->st.deleters_waiting++;
+    }
+    emit(list, EVENT_WAIT, op->role, op->ctx.value, 0, 0);
+    op->wait_start = wait_begin(list, op->role);
+    if (op->ctx.priority == PRIORITY_INTERACTIVE) {
+      atomic_fetch_add(&list->st.interactive_waiting[op->role], 1);
+    }
+    op->state = OP_WAITING;
+    /* fallthrough */
+  case OP_WAITING:
+    /* Same as priority_enter, but parks instead of blocking */
+    if (op->ctx.priority == PRIORITY_BACKGROUND &&
+        interactive_ahead(list, op->role)) {
+      return 0;
+    }
+    if (try_acquire[op->role](op) < 0) {
+      return 0;
+    }
+    priority_leave(list, &op->ctx, op->role);
+    void *ret = operate(&op->ctx, op->role);
+    op->result = op->role == ROLE_SEARCHER  ? ret != NULL
+                 : op->role == ROLE_DELETER ? *(int *)ret
+                                            : 1;
+    op->state = OP_DONE;
+    /* fallthrough */
+  case OP_DONE:
+    break;
+  }
 
-  return NULL;
+  return 1;
 }
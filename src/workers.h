@@ -1,7 +1,9 @@
 #ifndef _WORKERS_INCLUDE_H
 #define _WORKERS_INCLUDE_H
 
+#include "events.h"
 #include "linked-list.h"
+#include "work.h"
 
 /*
 All the operations take the same context since none of them take a position
@@ -10,16 +12,81 @@ as argument:
 - Search: Searches for the first ocurrence of value
 - Insert: Inserts value at the end of the list
 - Delete: Deletes the first ocurrence of value
+
+work is the simulated work done inside the critical section before operating
+on the list, by default none.
+
+slot is the searcher's handle in the list's state, set by
+llist_searcher_acquire and given back by llist_searcher_release.
+
+payload is what an inserter stores along with value if the list has payloads,
+NULL to zero it.
+
+priority is the operation's class, interactive unless set otherwise.
+
+ticket is the operation's admission ticket, if it was admitted with one (see
+admission.h), which whoever runs it must start before calling the functions
+below.
+
+tag is never touched by the workers, it's for whoever issued the operation to
+recognize it once it's done.
+
+Instead of list, an operation can address its list as list_id in keyspace (see
+keyspace.h), leaving list NULL until llist_ctx_resolve looks it up. The thread
+functions and llist_op_step do so before anything else.
 */
 
+struct admission_ticket;
+struct keyspace;
+
 typedef struct {
   llist *list;
   size_t value;
+  work_model work;
+  size_t slot;
+  const void *payload;
+  op_priority priority;
+  struct admission_ticket *ticket;
+  struct keyspace *keyspace;
+  size_t list_id;
+  void *tag;
 } llist_ctx;
 
+typedef enum {
+  OP_START,
+  /* Announced as waiting, trying to acquire the list */
+  OP_WAITING,
+  OP_DONE,
+} llist_op_state;
+
+/*
+An operation written as a stackless coroutine, for executors that can't afford
+to block a thread per waiting operation.
+
+Each call to llist_op_step resumes it from state: it tries to acquire the list
+without blocking and, if the SID condition doesn't hold, returns so the
+executor can park it until the list is released. Once it acquires the list it
+runs to completion, with result set as in the thread functions (found,
+deleted or 1 for inserts).
+*/
+typedef struct {
+  llist_ctx ctx;
+  worker_role role;
+  llist_op_state state;
+  uint64_t wait_start;
+  int result;
+} llist_op;
+
+/* Who an executor should resume after the list is released, 1 << role */
+#define WAKE_SEARCHERS 1u
+#define WAKE_INSERTER 2u
+#define WAKE_DELETER 4u
+
 void* searcher_thread(void*);
 void* inserter_thread(void*);
 void* deleter_thread(void*);
+int llist_op_step(llist_op*);
+void llist_ctx_resolve(llist_ctx*);
 
 int llist_searcher_acquire(llist_ctx*);
 int llist_searcher_release(llist_ctx*);
@@ -27,5 +94,8 @@ int llist_inserter_acquire(llist_ctx*);
 int llist_inserter_release(llist*);
 int llist_deleter_acquire(llist_ctx*);
 int llist_deleter_release(llist*);
+int llist_searcher_try_acquire(llist_op*);
+int llist_inserter_try_acquire(llist_op*);
+int llist_deleter_try_acquire(llist_op*);
 
 #endif
@@ -0,0 +1,323 @@
+#define _POSIX_C_SOURCE 200809L
+#include "workload.h"
+#include <limits.h>
+#include <math.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest number of outstanding operations, since a closed loop counts the
+ones it may still issue with a semaphore */
+#if SEM_VALUE_MAX < INT_MAX
+#define OUTSTANDING_MAX SEM_VALUE_MAX
+#else
+#define OUTSTANDING_MAX INT_MAX
+#endif
+
+/* The same run the demo always did: 10 initial values and 5 operations of
+each type, with keys in [1, 20] */
+void workload_defaults(workload *w) {
+  w->search_pct = 34;
+  w->insert_pct = 33;
+  w->delete_pct = 33;
+  for (int i = 0; i < 3; i++) {
+    w->background_pct[i] = 0;
+  }
+  w->keys = KEYS_UNIFORM;
+  w->key_range = 20;
+  w->zipf_theta = 0.99;
+  w->hot_keys = 0.2;
+  w->hot_ops = 0.8;
+  w->arrival = ARRIVAL_CLOSED;
+  w->rate = 0;
+  w->outstanding = 0;
+  w->total_ops = 15;
+  w->duration = 0;
+  w->initial_size = 10;
+  w->lists = 1;
+  w->payload_size = 0;
+  w->sorted = 0;
+  w->counted = 0;
+  w->dense_range = 0;
+  w->organize = LLIST_ORGANIZE_NONE;
+  w->seed = 0;
+}
+
+/* Returns NULL if w is valid, or a message explaining what's wrong */
+const char *workload_validate(const workload *w) {
+  if (w->search_pct + w->insert_pct + w->delete_pct != 100) {
+    return "the operation mix must add up to 100";
+  }
+  if (w->lists == 0) {
+    return "there must be at least one list";
+  }
+  if (w->key_range == 0) {
+    return "the key range must not be empty";
+  }
+  if (w->keys == KEYS_ZIPFIAN && (w->zipf_theta <= 0 || w->zipf_theta >= 1)) {
+    return "the zipfian theta must be in (0, 1)";
+  }
+  if (w->keys == KEYS_HOTSPOT && (w->hot_keys <= 0 || w->hot_keys >= 1 ||
+                                  w->hot_ops < 0 || w->hot_ops > 1)) {
+    return "the hotspot fractions must be in (0, 1)";
+  }
+  if (w->sorted && w->organize != LLIST_ORGANIZE_NONE) {
+    return "a sorted list can't be reorganized";
+  }
+  if ((w->counted || w->dense_range != 0) && w->payload_size != 0) {
+    return "counted and dense lists can't carry payloads";
+  }
+  if (w->arrival == ARRIVAL_OPEN && w->rate <= 0) {
+    return "an open-loop workload needs a positive rate";
+  }
+  if (w->outstanding > OUTSTANDING_MAX) {
+    return "too many outstanding operations";
+  }
+  if (w->total_ops == 0 && w->duration <= 0) {
+    return "either the number of operations or the duration must be set";
+  }
+  return NULL;
+}
+
+/* Parses "S:I:D" percentages, returns -1 if spec is invalid */
+static int parse_pcts(const char *spec, unsigned pct[3]) {
+  const char *cur = spec;
+
+  for (int i = 0; i < 3; i++) {
+    char *end;
+    unsigned long n = strtoul(cur, &end, 10);
+    if (end == cur || n > 100 || (i < 2 && *end != ':') ||
+        (i == 2 && *end != '\0')) {
+      return -1;
+    }
+    pct[i] = (unsigned)n;
+    cur = end + 1;
+  }
+  return 0;
+}
+
+int workload_parse_mix(const char *spec, workload *w) {
+  unsigned pct[3];
+  if (parse_pcts(spec, pct) < 0) {
+    return -1;
+  }
+
+  w->search_pct = pct[0];
+  w->insert_pct = pct[1];
+  w->delete_pct = pct[2];
+  return 0;
+}
+
+/*
+Parses a key distribution, one of:
+
+- uniform
+- zipfian[:THETA]
+- hotspot[:HOT_KEYS:HOT_OPS]
+- sequential
+
+Returns -1 if spec is invalid.
+*/
+int workload_parse_keys(const char *spec, workload *w) {
+  char *end;
+
+  if (strcmp(spec, "uniform") == 0) {
+    w->keys = KEYS_UNIFORM;
+  } else if (strcmp(spec, "sequential") == 0) {
+    w->keys = KEYS_SEQUENTIAL;
+  } else if (strncmp(spec, "zipfian", 7) == 0) {
+    if (spec[7] == ':') {
+      w->zipf_theta = strtod(spec + 8, &end);
+      if (end == spec + 8 || *end != '\0') {
+        return -1;
+      }
+    } else if (spec[7] != '\0') {
+      return -1;
+    }
+    w->keys = KEYS_ZIPFIAN;
+  } else if (strncmp(spec, "hotspot", 7) == 0) {
+    if (spec[7] == ':') {
+      w->hot_keys = strtod(spec + 8, &end);
+      if (end == spec + 8 || *end != ':') {
+        return -1;
+      }
+      const char *ops = end + 1;
+      w->hot_ops = strtod(ops, &end);
+      if (end == ops || *end != '\0') {
+        return -1;
+      }
+    } else if (spec[7] != '\0') {
+      return -1;
+    }
+    w->keys = KEYS_HOTSPOT;
+  } else {
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Parses none, move-to-front or transpose, returns -1 if spec is invalid */
+int workload_parse_organize(const char *spec, workload *w) {
+  if (strcmp(spec, "none") == 0) {
+    w->organize = LLIST_ORGANIZE_NONE;
+  } else if (strcmp(spec, "move-to-front") == 0) {
+    w->organize = LLIST_ORGANIZE_MOVE_TO_FRONT;
+  } else if (strcmp(spec, "transpose") == 0) {
+    w->organize = LLIST_ORGANIZE_TRANSPOSE;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+void workload_gen_init(workload_gen *g, const workload *w) {
+  g->w = w;
+  g->next_seq = 0;
+  rng_seed(&g->rng, w->seed, RNG_STREAM_WORKLOAD);
+
+  /* Split total_ops by the largest remainder method so the counts add up */
+  if (w->total_ops != 0) {
+    unsigned pct[3] = {w->search_pct, w->insert_pct, w->delete_pct};
+    size_t rem[3];
+    size_t assigned = 0;
+    for (int r = 0; r < 3; r++) {
+      g->left[r] = w->total_ops * pct[r] / 100;
+      rem[r] = w->total_ops * pct[r] % 100;
+      assigned += g->left[r];
+    }
+    while (assigned < w->total_ops) {
+      int best = 0;
+      for (int r = 1; r < 3; r++) {
+        if (rem[r] > rem[best]) {
+          best = r;
+        }
+      }
+      g->left[best]++;
+      rem[best] = 0;
+      assigned++;
+    }
+  }
+
+  if (w->keys == KEYS_ZIPFIAN) {
+    /* Constants from "Quickly Generating Billion-Record Synthetic Databases"
+    (Gray et al.), the same generator YCSB uses */
+    double theta = w->zipf_theta;
+    double n = (double)w->key_range;
+    double zeta2 = 1.0 + pow(0.5, theta);
+    g->zetan = 0;
+    for (size_t i = 1; i <= w->key_range; i++) {
+      g->zetan += 1.0 / pow((double)i, theta);
+    }
+    g->alpha = 1.0 / (1.0 - theta);
+    g->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / g->zetan);
+  }
+}
+
+/* Draws the role of the next operation, returns 0 once total_ops operations
+were issued */
+int workload_next_role(workload_gen *g, worker_role *role) {
+  const workload *w = g->w;
+
+  if (w->total_ops != 0) {
+    size_t left = g->left[0] + g->left[1] + g->left[2];
+    if (left == 0) {
+      return 0;
+    }
+    /* Sample without replacement so the mix is exact */
+    size_t pick = (size_t)rng_below(&g->rng, left);
+    int r = 0;
+    while (pick >= g->left[r]) {
+      pick -= g->left[r];
+      r++;
+    }
+    g->left[r]--;
+    *role = (worker_role)r;
+    return 1;
+  }
+
+  unsigned pick = (unsigned)rng_below(&g->rng, 100);
+  if (pick < w->search_pct) {
+    *role = ROLE_SEARCHER;
+  } else if (pick < w->search_pct + w->insert_pct) {
+    *role = ROLE_INSERTER;
+  } else {
+    *role = ROLE_DELETER;
+  }
+  return 1;
+}
+
+/* Parses the "S:I:D" percentages of each role issued as background operations,
+returns -1 if spec is invalid */
+int workload_parse_background(const char *spec, workload *w) {
+  return parse_pcts(spec, w->background_pct);
+}
+
+/* Draws the priority of the next operation of role. Nothing is drawn unless
+the role mixes both classes, so the other choices of a seed stay the same */
+op_priority workload_next_priority(workload_gen *g, worker_role role) {
+  unsigned pct = g->w->background_pct[role];
+  if (pct == 0) {
+    return PRIORITY_INTERACTIVE;
+  }
+  if (pct >= 100) {
+    return PRIORITY_BACKGROUND;
+  }
+  return rng_below(&g->rng, 100) < pct ? PRIORITY_BACKGROUND
+                                       : PRIORITY_INTERACTIVE;
+}
+
+/* Draws the list of the next operation, in [0, lists). Nothing is drawn for a
+single list */
+size_t workload_next_list(workload_gen *g) {
+  if (g->w->lists <= 1) {
+    return 0;
+  }
+  return (size_t)rng_below(&g->rng, g->w->lists);
+}
+
+/* Draws the key of the next operation, in [1, key_range] */
+size_t workload_next_key(workload_gen *g) {
+  const workload *w = g->w;
+  size_t n = w->key_range;
+
+  switch (w->keys) {
+  case KEYS_UNIFORM:
+    break;
+  case KEYS_ZIPFIAN: {
+    double u = rng_unit(&g->rng);
+    double uz = u * g->zetan;
+    if (uz < 1.0) {
+      return 1;
+    }
+    if (uz < 1.0 + pow(0.5, w->zipf_theta)) {
+      return n < 2 ? 1 : 2;
+    }
+    size_t key = 1 + (size_t)((double)n * pow(g->eta * u - g->eta + 1.0,
+                                               g->alpha));
+    return key > n ? n : key;
+  }
+  case KEYS_HOTSPOT: {
+    size_t hot = (size_t)((double)n * w->hot_keys);
+    if (hot == 0) {
+      hot = 1;
+    }
+    if (hot >= n) {
+      break;
+    }
+    if (rng_unit(&g->rng) < w->hot_ops) {
+      return 1 + (size_t)rng_below(&g->rng, hot);
+    }
+    return hot + 1 + (size_t)rng_below(&g->rng, n - hot);
+  }
+  case KEYS_SEQUENTIAL:
+    return 1 + g->next_seq++ % n;
+  }
+
+  return 1 + (size_t)rng_below(&g->rng, n);
+}
+
+/* Time until the next arrival of an open-loop workload */
+uint64_t workload_next_gap_ns(workload_gen *g) {
+  return (uint64_t)(-log(1.0 - rng_unit(&g->rng)) / g->w->rate * 1e9);
+}
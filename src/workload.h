@@ -0,0 +1,113 @@
+#ifndef _WORKLOAD_INCLUDE_H
+#define _WORKLOAD_INCLUDE_H
+
+#include "events.h"
+#include "rng.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+How keys are drawn from [1, key_range]:
+
+- KEYS_UNIFORM: Every key is equally likely
+- KEYS_ZIPFIAN: Key k has probability proportional to 1/k^zipf_theta, so 1 is
+  the hottest key
+- KEYS_HOTSPOT: hot_ops of the operations go to the first hot_keys fraction of
+  the keys, the rest go to the other keys
+- KEYS_SEQUENTIAL: 1, 2, ..., key_range, 1, 2, ...
+*/
+typedef enum {
+  KEYS_UNIFORM,
+  KEYS_ZIPFIAN,
+  KEYS_HOTSPOT,
+  KEYS_SEQUENTIAL,
+} key_dist;
+
+/*
+How operations are issued:
+
+- ARRIVAL_CLOSED: At most outstanding operations are in flight, a new one is
+  issued as soon as one finishes
+- ARRIVAL_OPEN: Operations arrive as a Poisson process of rate operations per
+  second, regardless of how many are still in flight
+*/
+typedef enum {
+  ARRIVAL_CLOSED,
+  ARRIVAL_OPEN,
+} arrival_kind;
+
+/*
+Description of the traffic of a run. The run stops after total_ops operations
+or after duration seconds, whichever comes first, 0 disables either limit but
+not both. When total_ops is set the mix is exact (e.g. 15 operations with
+34/33/33 are 5 of each), otherwise each operation draws its role from it.
+
+If payload_size is set, the list is a key/value list whose nodes carry that
+many bytes of payload. If sorted is set, the list is kept in key order,
+otherwise organize tells how it adapts to the keys that are searched. If
+counted is set, equal keys share a node holding their count. If dense_range is
+set, the list turns into an array of counts while its keys span at most that
+many values.
+
+lists is the number of independent lists the operations are spread over,
+uniformly, each of them starting with initial_size values.
+
+background_pct is the percentage of the operations of each role issued as
+background operations, by default none.
+
+Every random choice is derived from seed, so the same workload always issues
+the same operations. A seed of 0 means that the run picks one.
+*/
+typedef struct {
+  unsigned search_pct;
+  unsigned insert_pct;
+  unsigned delete_pct;
+  unsigned background_pct[3];
+  key_dist keys;
+  size_t key_range;
+  double zipf_theta;
+  double hot_keys;
+  double hot_ops;
+  arrival_kind arrival;
+  double rate;
+  size_t outstanding;
+  size_t total_ops;
+  double duration;
+  size_t initial_size;
+  size_t lists;
+  size_t payload_size;
+  int sorted;
+  int counted;
+  size_t dense_range;
+  llist_organize organize;
+  uint64_t seed;
+} workload;
+
+/* Generation state of a workload, only used by the thread issuing operations */
+typedef struct {
+  const workload *w;
+  rng rng;
+  /* Operations of each role left when total_ops is set */
+  size_t left[3];
+  size_t next_seq;
+  /* Precomputed zipfian constants */
+  double zetan;
+  double alpha;
+  double eta;
+} workload_gen;
+
+void workload_defaults(workload *w);
+const char *workload_validate(const workload *w);
+int workload_parse_mix(const char *spec, workload *w);
+int workload_parse_keys(const char *spec, workload *w);
+int workload_parse_background(const char *spec, workload *w);
+int workload_parse_organize(const char *spec, workload *w);
+
+void workload_gen_init(workload_gen *g, const workload *w);
+int workload_next_role(workload_gen *g, worker_role *role);
+size_t workload_next_key(workload_gen *g);
+op_priority workload_next_priority(workload_gen *g, worker_role role);
+size_t workload_next_list(workload_gen *g);
+uint64_t workload_next_gap_ns(workload_gen *g);
+
+#endif
@@ -1,8 +1,33 @@
-#include "../src/int-list.h"
+#define _POSIX_C_SOURCE 200809L
+#include "../src/admission.h"
+#include "../src/affinity.h"
+#include "../src/deque.h"
+#include "../src/executor.h"
+#include "../src/histogram.h"
+#include "../src/keyspace.h"
 #include "../src/linked-list.h"
+#include "../src/op-trace.h"
+#include "../src/protocol.h"
+#include "../src/rng.h"
+#include "../src/sched.h"
+#include "../src/search-batch.h"
+#include "../src/server.h"
+#include "../src/shm-list.h"
+#include "../src/slots.h"
+#include "../src/work.h"
 #include "../src/workers.h"
+#include "../src/workload.h"
 #include "greatest.h"
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 /* Assert that creating and freeing a linked list incurs no memory leaks, note
  * that this test may pass but still trigger the address sanitizer, which is
@@ -85,12 +110,265 @@ TEST find_simple(void) {
   PASS();
 }
 
+/* Payloads are stored with their node and updated in place */
+TEST key_value_payloads(void) {
+  typedef struct {
+    double price;
+    char name[24];
+  } item;
+  llist_opts opts = {.payload_size = sizeof(item)};
+  llist *list = llist_new_with(&opts);
+
+  item apple = {.price = 1.5, .name = "apple"};
+  item pear = {.price = 2.25, .name = "pear"};
+  llist_push_back_kv(list, 1, &apple);
+  llist_push_back_kv(list, 2, &pear);
+  llist_push_back(list, 3);
+
+  item *found = llist_find_payload(list, 2);
+  ASSERT(found != NULL);
+  ASSERT_STR_EQ("pear", found->name);
+  ASSERT_EQ((void *)found, (void *)llist_find(list, 2)->payload);
+  ASSERT_EQ(llist_find_payload(list, 4), NULL);
+  /* Nodes pushed without a payload have it zeroed */
+  ASSERT_EQ(((item *)llist_find_payload(list, 3))->price, 0);
+
+  pear.price = 3;
+  ASSERT_EQ(llist_update(list, 2, &pear), 1);
+  ASSERT_EQ(found->price, 3);
+  ASSERT_EQ(llist_update(list, 4, &pear), 0);
+
+  ASSERT_EQ(llist_delete(list, 1), 1);
+  ASSERT_STR_EQ("pear", ((item *)llist_find_payload(list, 2))->name);
+
+  llist_free(list);
+  PASS();
+}
+
+static void count_node(lnode *node, void *arg) {
+  (void)node;
+  (*(size_t *)arg)++;
+}
+
+/* Insert out of order into a sorted list and check the order, that lookups
+ * past the key give up and that a range only sees its span */
+TEST sorted_list(void) {
+  llist_opts opts = {.sorted = 1};
+  llist *list = llist_new_with(&opts);
+  size_t keys[] = {5, 1, 9, 3, 7, 3};
+
+  for (size_t i = 0; i < 6; i++) {
+    llist_push_back(list, keys[i]);
+  }
+  size_t prev = 0;
+  for (lnode *cur = list->head; cur != NULL; cur = cur->next) {
+    ASSERT(cur->value >= prev);
+    prev = cur->value;
+  }
+  ASSERT_EQ(prev, 9);
+
+  ASSERT_EQ(llist_find(list, 4), NULL);
+  ASSERT_EQ(llist_find(list, 7)->value, 7);
+  ASSERT_EQ(llist_delete(list, 4), 0);
+  ASSERT_EQ(llist_delete(list, 3), 1);
+
+  size_t seen = 0;
+  ASSERT_EQ(llist_find_range(list, 2, 7, count_node, &seen), 3);
+  ASSERT_EQ(seen, 3);
+  ASSERT_EQ(llist_find_range(list, 10, 20, count_node, &seen), 0);
+
+  llist_free(list);
+  PASS();
+}
+
+/* Search for the tail of a self-organizing list and check it only moves once
+ * the list is maintained */
+TEST organize_policies(void) {
+  llist_opts opts = {.organize = LLIST_ORGANIZE_MOVE_TO_FRONT};
+  llist *list = llist_new_with(&opts);
+  for (size_t i = 1; i <= 4; i++) {
+    llist_push_back(list, i);
+  }
+
+  ASSERT(llist_find(list, 4) != NULL);
+  ASSERT(llist_find(list, 5) == NULL);
+  ASSERT_EQ(list->head->value, 1);
+  ASSERT_EQ(llist_maintain(list), 1);
+  ASSERT_EQ(list->head->value, 4);
+  ASSERT_EQ(list->head->next->value, 1);
+  ASSERT_EQ(llist_maintain(list), 0);
+
+  list->organize = LLIST_ORGANIZE_TRANSPOSE;
+  llist_find(list, 3);
+  llist_maintain(list);
+  /* 4 -> 1 -> 2 -> 3 becomes 4 -> 1 -> 3 -> 2 */
+  ASSERT_EQ(list->head->next->next->value, 3);
+  ASSERT_EQ(list->head->next->next->next->value, 2);
+  ASSERT_EQ(list->len, 4);
+
+  llist_free(list);
+  PASS();
+}
+
+/* Push many duplicates into a counted list and check they share nodes while
+ * lookups and deletes behave as in a plain list */
+TEST counted_list(void) {
+  llist_opts opts = {.counted = 1};
+  llist *list = llist_new_with(&opts);
+  for (size_t i = 0; i < 1000; i++) {
+    llist_push_back(list, 1 + i % 5);
+  }
+  ASSERT_EQ(list->len, 1000);
+  ASSERT_EQ(list->nodes, 5);
+  ASSERT_EQ(llist_count(list, 3), 200);
+  ASSERT_EQ(llist_count(list, 6), 0);
+
+  for (size_t i = 0; i < 200; i++) {
+    ASSERT_EQ(llist_delete(list, 3), 1);
+  }
+  ASSERT_EQ(llist_find(list, 3), NULL);
+  ASSERT_EQ(llist_delete(list, 3), 0);
+  ASSERT_EQ(list->len, 800);
+  ASSERT_EQ(list->nodes, 4);
+
+  size_t nodes = 0;
+  ASSERT_EQ(llist_find_range(list, 1, 2, count_node, &nodes), 400);
+  ASSERT_EQ(nodes, 2);
+
+  llist_free(list);
+  PASS();
+}
+
+/* Let a list go dense, check it still behaves as a list, then push enough keys
+ * outside its range for it to go back */
+TEST dense_switch(void) {
+  llist_opts opts = {.dense_range = 10};
+  llist *list = llist_new_with(&opts);
+  for (size_t i = 0; i < 100; i++) {
+    llist_push_back(list, 1 + i % 10);
+  }
+  llist_maintain(list);
+  ASSERT(list->dense);
+  ASSERT_EQ(list->nodes, 0);
+  ASSERT_EQ(llist_find(list, 4)->value, 4);
+  ASSERT_EQ(llist_count(list, 4), 10);
+  ASSERT_EQ(llist_delete(list, 4), 1);
+  ASSERT_EQ(llist_count(list, 4), 9);
+
+  /* Keys outside the range get nodes until there are too many of them */
+  for (size_t i = 0; i <= LLIST_DENSE_SPILL; i++) {
+    llist_push_back(list, 100 + i);
+  }
+  ASSERT_EQ(llist_find(list, 100)->value, 100);
+  size_t keys[] = {4, 100};
+  lnode *found[2];
+  ASSERT_EQ(llist_find_many(list, keys, 2, found), 2);
+  llist_maintain(list);
+  ASSERT_FALSE(list->dense);
+  ASSERT_EQ(list->len, 99 + LLIST_DENSE_SPILL + 1);
+  ASSERT_EQ(list->nodes, list->len);
+  ASSERT_EQ(llist_count(list, 4), 9);
+
+  llist_free(list);
+  PASS();
+}
+
+/* A dense list whose low keys were all deleted is narrowed to the keys it
+ * still has when it grows past its high end */
+TEST dense_narrows(void) {
+  llist_opts opts = {.dense_range = 200};
+  llist *list = llist_new_with(&opts);
+  for (size_t i = 1; i <= 100; i++) {
+    llist_push_back(list, i);
+  }
+  llist_maintain(list);
+  ASSERT(list->dense);
+  for (size_t i = 1; i <= 50; i++) {
+    ASSERT_EQ(llist_delete(list, i), 1);
+  }
+  for (size_t i = 150; i <= 166; i++) {
+    llist_push_back(list, i);
+  }
+  llist_maintain(list);
+  ASSERT(list->dense);
+  ASSERT_EQ(list->dense_lo, 51);
+  ASSERT_EQ(list->dense_len, 116);
+  ASSERT_EQ(list->len, 67);
+  ASSERT_EQ(llist_count(list, 51), 1);
+  ASSERT_EQ(llist_count(list, 166), 1);
+  ASSERT_EQ(llist_find(list, 50), NULL);
+
+  llist_free(list);
+  PASS();
+}
+
+/* Once the only key outside the range is deleted the list can go dense */
+TEST dense_after_wide_key(void) {
+  llist_opts opts = {.dense_range = 10};
+  llist *list = llist_new_with(&opts);
+  for (size_t i = 1; i <= 5; i++) {
+    llist_push_back(list, i);
+  }
+  llist_push_back(list, 1000);
+  llist_maintain(list);
+  ASSERT_FALSE(list->dense);
+
+  ASSERT_EQ(llist_delete(list, 1000), 1);
+  llist_maintain(list);
+  ASSERT(list->dense);
+  ASSERT_EQ(list->dense_lo, 1);
+  ASSERT_EQ(llist_count(list, 3), 1);
+
+  llist_free(list);
+  PASS();
+}
+
+static void sum_values(size_t value, void *arg) { *(size_t *)arg += value; }
+
+/* Take more slots than fit in the first segment, give some back and check that
+ * they are reused and that foreach only sees the taken ones */
+TEST slots_grow_and_reuse(void) {
+  slot_registry reg;
+  size_t handles[1000];
+  size_t sum = 0;
+
+  slots_init(&reg);
+  for (size_t i = 0; i < 1000; i++) {
+    handles[i] = slots_acquire(&reg, i + 1);
+  }
+  ASSERT_EQ_FMT((size_t)1000, slots_len(&reg), "%zu");
+
+  for (size_t i = 0; i < 1000; i += 2) {
+    slots_release(&reg, handles[i]);
+  }
+  ASSERT_EQ_FMT((size_t)500, slots_len(&reg), "%zu");
+
+  /* Only even values are left */
+  slots_foreach(&reg, sum_values, &sum);
+  ASSERT_EQ_FMT((size_t)(500 * 501), sum, "%zu");
+
+  /* The freed slot is handed out again instead of a new one */
+  size_t handle = slots_acquire(&reg, 7);
+  ASSERT_EQ_FMT(handles[998], handle, "%zu");
+
+  slots_destroy(&reg);
+  PASS();
+}
+
 SUITE(llist_suite) {
   RUN_TEST(create_empty_list);
   RUN_TEST(insert_simple);
   RUN_TEST(delete_empty_list);
   RUN_TEST(insert_and_delete);
   RUN_TEST(find_simple);
+  RUN_TEST(key_value_payloads);
+  RUN_TEST(sorted_list);
+  RUN_TEST(organize_policies);
+  RUN_TEST(counted_list);
+  RUN_TEST(dense_switch);
+  RUN_TEST(dense_narrows);
+  RUN_TEST(dense_after_wide_key);
+  RUN_TEST(slots_grow_and_reuse);
 }
 
 /* Use trywait to check whether semaphore is locked and return errno */
@@ -110,7 +388,7 @@ void *inserter_acquire(void *arg) {
 TEST concurrent_inserters(void) {
   llist *list = llist_new();
   pthread_t thread;
-  llist_ctx ctx = {list, 0};
+  llist_ctx ctx = {.list = list, .value = 0};
 
   llist_inserter_acquire(&ctx);
 
@@ -143,7 +421,7 @@ void *deleter_acquire(void *arg) {
 TEST concurrent_deleters(void) {
   llist *list = llist_new();
   pthread_t thread;
-  llist_ctx ctx = {list, 0};
+  llist_ctx ctx = {.list = list, .value = 0};
   llist_inserter_acquire(&ctx);
 
   pthread_create(&thread, NULL, deleter_acquire, &ctx);
@@ -163,7 +441,7 @@ TEST concurrent_deleters(void) {
 TEST inserters_and_deleters(void) {
   llist *list = llist_new();
   pthread_t thread;
-  llist_ctx ctx = {list, 0};
+  llist_ctx ctx = {.list = list, .value = 0};
   int *result;
 
   llist_inserter_acquire(&ctx);
@@ -189,7 +467,7 @@ TEST inserters_and_deleters(void) {
 TEST inserters_and_searchers(void) {
   llist *list = llist_new();
   pthread_t thread;
-  llist_ctx ctx = {list, 0};
+  llist_ctx ctx = {.list = list, .value = 0};
   int *result;
 
   llist_searcher_acquire(&ctx);
@@ -207,7 +485,7 @@ TEST inserters_and_searchers(void) {
 TEST deleters_and_searchers(void) {
   llist *list = llist_new();
   pthread_t thread;
-  llist_ctx ctx = {list, 0};
+  llist_ctx ctx = {.list = list, .value = 0};
   int *result;
 
   llist_searcher_acquire(&ctx);
@@ -267,6 +545,589 @@ TEST insert_then_delete(void) {
   PASS();
 }
 
+/* Run many more operations than there are threads in the pool, checking that
+ * every one of them was executed */
+TEST pool_runs_every_task(void) {
+  llist *list = llist_new();
+  worker_pool pool;
+
+  worker_pool_init(&pool, 4);
+  for (size_t i = 1; i <= 500; i++) {
+    worker_pool_submit(&pool, inserter_thread,
+                       (llist_ctx){.list = list, .value = i});
+  }
+  worker_pool_join(&pool);
+  ASSERT_EQ_FMT((size_t)500, list->len, "%zu");
+  /* Every task came from an inbox, either the thread's own or a victim's */
+  ASSERT_EQ_FMT((size_t)500, pool.inboxed + pool.steals, "%zu");
+
+  worker_pool_init(&pool, 3);
+  for (size_t i = 1; i <= 500; i++) {
+    worker_pool_submit(&pool, deleter_thread,
+                       (llist_ctx){.list = list, .value = i});
+  }
+  worker_pool_join(&pool);
+  ASSERT_EQ(list->head, NULL);
+
+  llist_free(list);
+  PASS();
+}
+
+/* Tasks submitted from inside a pool thread go to its own deque, while the one
+ * submitted from outside comes through an inbox */
+static worker_pool *nested_pool;
+
+static void *submit_inserters(void *args) {
+  llist_ctx *ctx = args;
+  for (size_t i = 1; i <= 200; i++) {
+    worker_pool_submit(nested_pool, inserter_thread,
+                       (llist_ctx){.list = ctx->list, .value = i});
+  }
+  return NULL;
+}
+
+TEST pool_steals_nested_tasks(void) {
+  llist *list = llist_new();
+  worker_pool pool;
+  nested_pool = &pool;
+
+  worker_pool_init(&pool, 4);
+  worker_pool_submit(&pool, submit_inserters, (llist_ctx){.list = list});
+  worker_pool_join(&pool);
+
+  ASSERT_EQ_FMT((size_t)200, list->len, "%zu");
+  ASSERT_EQ_FMT((size_t)1, pool.submitted, "%zu");
+  ASSERT(pool.inboxed + pool.steals >= 1);
+
+  llist_free(list);
+  PASS();
+}
+
+/* Push and take from the owner end, and steal from the other, past the
+ * initial size of the deque */
+TEST deque_owner_and_thief_ends(void) {
+  deque q;
+  size_t items[100];
+  void *item;
+
+  deque_init(&q, 4);
+  ASSERT_EQ(deque_take(&q), NULL);
+  ASSERT_EQ(deque_steal(&q, &item), DEQUE_EMPTY);
+
+  for (size_t i = 0; i < 100; i++) {
+    items[i] = i;
+    deque_push(&q, &items[i]);
+  }
+  ASSERT_EQ(deque_steal(&q, &item), DEQUE_OK);
+  ASSERT_EQ(item, &items[0]);
+  ASSERT_EQ(deque_take(&q), &items[99]);
+
+  deque_destroy(&q);
+  PASS();
+}
+
+/* Many more operations than executor threads wait for the list at the same
+ * time, so most of them must be parked and resumed */
+TEST executor_runs_coroutines(void) {
+  llist *list = llist_new();
+  executor ex;
+
+  executor_init(&ex, 2, NULL);
+  list->st.executor = &ex;
+  for (size_t i = 1; i <= 300; i++) {
+    executor_submit(&ex, ROLE_INSERTER, (llist_ctx){.list = list, .value = i});
+    executor_submit(&ex, ROLE_SEARCHER, (llist_ctx){.list = list, .value = i});
+  }
+  executor_join(&ex);
+  ASSERT_EQ_FMT((size_t)300, list->len, "%zu");
+
+  executor_init(&ex, 3, NULL);
+  list->st.executor = &ex;
+  for (size_t i = 1; i <= 300; i++) {
+    executor_submit(&ex, ROLE_DELETER, (llist_ctx){.list = list, .value = i});
+    executor_submit(&ex, ROLE_SEARCHER, (llist_ctx){.list = list, .value = i});
+  }
+  executor_join(&ex);
+  ASSERT_EQ(list->head, NULL);
+  ASSERT_EQ_FMT(0, list->searcher_count, "%d");
+
+  llist_free(list);
+  PASS();
+}
+
+/* Waits up to a second for the executor to park n operations or, if n is 0, to
+ * finish every operation, returns whether it did */
+static int executor_reaches(executor *ex, size_t n) {
+  work_model pause;
+  work_parse("sleep:1000", &pause);
+  for (int i = 0; i < 1000; i++) {
+    pthread_mutex_lock(&ex->lock);
+    size_t parks = ex->parks;
+    pthread_mutex_unlock(&ex->lock);
+    if (n == 0 ? atomic_load(&ex->pending) == 0 : parks >= n) {
+      return 1;
+    }
+    work_run(&pause);
+  }
+  return 0;
+}
+
+/* Park a background deleter and then an interactive one while an inserter
+ * holds the list. Its release resumes a single deleter, which must be the
+ * interactive one: the background one would only park again to give way to
+ * it, and with the list free nobody would wake either of them */
+TEST executor_mixed_priorities(void) {
+  llist *list = llist_new();
+  executor ex;
+  llist_push_back(list, 1);
+  llist_push_back(list, 2);
+
+  executor_init(&ex, 2, NULL);
+  list->st.executor = &ex;
+  llist_ctx holder = {.list = list, .value = 3};
+  llist_inserter_acquire(&holder);
+  executor_submit(&ex, ROLE_DELETER,
+                  (llist_ctx){.list = list,
+                              .value = 1,
+                              .priority = PRIORITY_BACKGROUND});
+  ASSERT(executor_reaches(&ex, 1));
+  executor_submit(&ex, ROLE_DELETER, (llist_ctx){.list = list, .value = 2});
+  ASSERT(executor_reaches(&ex, 2));
+
+  llist_inserter_release(list);
+  ASSERT(executor_reaches(&ex, 0));
+  executor_join(&ex);
+  ASSERT_EQ(list->head, NULL);
+
+  llist_free(list);
+  PASS();
+}
+
+/* Operations over the queue limit are rejected, or make room by dropping the
+ * oldest one that didn't start yet */
+TEST admission_policies(void) {
+  admission a;
+  admission_ticket *t[4];
+  size_t limit[3];
+
+  ASSERT_EQ(admission_parse_limits("1:2:3", limit), 0);
+  ASSERT_EQ_FMT((size_t)2, limit[ROLE_INSERTER], "%zu");
+  ASSERT_EQ(admission_parse_limits("1:2", limit), -1);
+  ASSERT_EQ(admission_parse_limits("1:4294967296:3", limit), -1);
+  ASSERT_EQ(admission_parse_limits("2", limit), 0);
+  ASSERT_EQ_FMT((size_t)2, limit[ROLE_DELETER], "%zu");
+
+  admission_init(&a, OVERLOAD_REJECT, limit);
+  ASSERT_EQ(admission_admit(&a, ROLE_SEARCHER, &t[0]), 0);
+  ASSERT_EQ(admission_admit(&a, ROLE_SEARCHER, &t[1]), 0);
+  ASSERT_EQ(admission_admit(&a, ROLE_SEARCHER, &t[2]), -1);
+  /* Limits are per role */
+  ASSERT_EQ(admission_admit(&a, ROLE_DELETER, &t[3]), 0);
+  admission_done(&a, ROLE_SEARCHER, t[0]);
+  ASSERT_EQ(admission_admit(&a, ROLE_SEARCHER, &t[2]), 0);
+  ASSERT_EQ_FMT((size_t)1, atomic_load(&a.rejected[ROLE_SEARCHER]), "%zu");
+  admission_destroy(&a);
+
+  admission_init(&a, OVERLOAD_DROP_OLDEST, limit);
+  ASSERT_EQ(admission_admit(&a, ROLE_INSERTER, &t[0]), 0);
+  ASSERT_EQ(admission_admit(&a, ROLE_INSERTER, &t[1]), 0);
+  ASSERT_EQ(admission_admit(&a, ROLE_INSERTER, &t[2]), 0);
+  ASSERT_EQ_FMT((size_t)1, atomic_load(&a.dropped[ROLE_INSERTER]), "%zu");
+  ASSERT_EQ(admission_start(t[0]), -1);
+  ASSERT_EQ(admission_start(t[1]), 0);
+  ASSERT_EQ(admission_start(t[2]), 0);
+  /* Nothing left to drop once every queued operation started */
+  ASSERT_EQ(admission_admit(&a, ROLE_INSERTER, &t[3]), -1);
+  ASSERT_EQ_FMT((size_t)1, atomic_load(&a.rejected[ROLE_INSERTER]), "%zu");
+  admission_done(&a, ROLE_INSERTER, t[1]);
+  admission_done(&a, ROLE_INSERTER, t[2]);
+  ASSERT_EQ_FMT((size_t)0, atomic_load(&a.queued[ROLE_INSERTER]), "%zu");
+  admission_destroy(&a);
+  PASS();
+}
+
+typedef struct {
+  search_batch *batch;
+  llist *list;
+  size_t first;
+  size_t wrong;
+} batched_searcher;
+
+/* Searches for 50 values from first, counting the wrong answers. Keys up to
+ * 100 are in the list */
+static void *batched_searches(void *arg) {
+  batched_searcher *s = arg;
+  for (size_t v = s->first; v < s->first + 50; v++) {
+    lnode *node = search_batch_find(s->batch, s->list, v);
+    if (v <= 100 ? node == NULL || node->value != v : node != NULL) {
+      s->wrong++;
+    }
+  }
+  return NULL;
+}
+
+/* Every searcher gets its own answer out of the shared traversals */
+TEST search_batches(void) {
+  llist *list = llist_new();
+  search_batch batch;
+  pthread_t threads[4];
+  batched_searcher searchers[4];
+
+  for (size_t i = 1; i <= 100; i++) {
+    llist_push_back(list, i);
+  }
+  size_t keys[] = {100, 7, 500, 7};
+  lnode *found[4];
+  ASSERT_EQ_FMT((size_t)3, llist_find_many(list, keys, 4, found), "%zu");
+  ASSERT_EQ(found[2], NULL);
+  ASSERT_EQ(found[1], found[3]);
+  ASSERT_EQ_FMT((size_t)100, found[0]->value, "%zu");
+
+  search_batch_init(&batch);
+  for (size_t i = 0; i < 4; i++) {
+    searchers[i] = (batched_searcher){
+        .batch = &batch, .list = list, .first = 1 + i * 30, .wrong = 0};
+    pthread_create(&threads[i], NULL, batched_searches, &searchers[i]);
+  }
+  for (size_t i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+    ASSERT_EQ_FMT((size_t)0, searchers[i].wrong, "%zu");
+  }
+  ASSERT_EQ_FMT((size_t)200, batch.searches, "%zu");
+  ASSERT(batch.scans <= batch.searches);
+  search_batch_destroy(&batch);
+
+  llist_free(list);
+  PASS();
+}
+
+/* A background deleter doesn't start waiting while an interactive searcher
+ * it would delay is, and background tasks still all run */
+TEST background_gives_way(void) {
+  llist *list = llist_new();
+  pthread_t deleter;
+  workload wl;
+
+  workload_defaults(&wl);
+  ASSERT_EQ(workload_parse_background("0:50", &wl), -1);
+  ASSERT_EQ(workload_parse_background("0:0:100", &wl), 0);
+
+  llist_push_back(list, 1);
+  atomic_store(&list->st.interactive_waiting[ROLE_SEARCHER], 1);
+  llist_ctx ctx = {.list = list, .value = 1, .priority = PRIORITY_BACKGROUND};
+  pthread_create(&deleter, NULL, deleter_thread, &ctx);
+  work_model pause;
+  work_parse("sleep:20000", &pause);
+  work_run(&pause);
+  ASSERT_EQ_FMT((size_t)1, list->len, "%zu");
+
+  /* What the searcher does once it gets in */
+  atomic_store(&list->st.interactive_waiting[ROLE_SEARCHER], 0);
+  pthread_mutex_lock(&list->st.lock);
+  pthread_cond_broadcast(&list->st.interactive_left);
+  pthread_mutex_unlock(&list->st.lock);
+  pthread_join(deleter, NULL);
+  ASSERT_EQ(list->head, NULL);
+
+  worker_pool pool;
+  worker_pool_init(&pool, 3);
+  for (size_t i = 1; i <= 200; i++) {
+    worker_pool_submit(&pool, inserter_thread,
+                       (llist_ctx){.list = list,
+                                   .value = i,
+                                   .priority = (op_priority)(i % 2)});
+  }
+  worker_pool_join(&pool);
+  ASSERT_EQ_FMT((size_t)200, list->len, "%zu");
+
+  llist_free(list);
+  PASS();
+}
+
+/* Pinned pool threads still run every task, and CPU lists are checked against
+ * the CPUs available to the process */
+TEST affinity_policies(void) {
+  affinity a;
+  worker_pool pool;
+
+  ASSERT_EQ(affinity_parse("compact", &a), 0);
+  ASSERT(a.ncpus >= 1);
+  int first = a.cpus[0];
+  /* Every pool thread must still run when pinned */
+  llist *list = llist_new();
+  worker_pool_init_placed(&pool, 3, &a);
+  for (size_t i = 1; i <= 30; i++) {
+    worker_pool_submit(&pool, inserter_thread,
+                       (llist_ctx){.list = list, .value = i});
+  }
+  worker_pool_join(&pool);
+  ASSERT_EQ_FMT((size_t)30, list->len, "%zu");
+  llist_free(list);
+  affinity_free(&a);
+
+  ASSERT_EQ(affinity_parse("split", &a), 0);
+  ASSERT(a.split < a.ncpus);
+  affinity_free(&a);
+
+  char spec[32];
+  snprintf(spec, sizeof(spec), "list:%d", first);
+  ASSERT_EQ(affinity_parse(spec, &a), 0);
+  ASSERT_EQ_FMT((size_t)1, a.ncpus, "%zu");
+  affinity_free(&a);
+
+  ASSERT_EQ(affinity_parse("list:", &a), -1);
+  ASSERT_EQ(affinity_parse("list:3-1", &a), -1);
+  ASSERT_EQ(affinity_parse("everywhere", &a), -1);
+  PASS();
+}
+
+typedef struct {
+  keyspace *ks;
+  size_t ids[16];
+} keyspace_opener;
+
+static void *open_lists(void *arg) {
+  keyspace_opener *o = arg;
+  char name[KEYSPACE_NAME_MAX];
+  for (size_t i = 0; i < 16; i++) {
+    snprintf(name, sizeof(name), "list-%zu", i);
+    keyspace_open(o->ks, name, &o->ids[i]);
+  }
+  return NULL;
+}
+
+/* Open the same names from several threads at once, check that they all get
+ * the same lists, then run operations addressed by id on them */
+TEST keyspace_registry(void) {
+  keyspace ks;
+  llist_opts opts = {0};
+  keyspace_opener openers[4];
+  pthread_t threads[4];
+
+  keyspace_init(&ks, 16, &opts);
+  for (int i = 0; i < 4; i++) {
+    openers[i].ks = &ks;
+    pthread_create(&threads[i], NULL, open_lists, &openers[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  ASSERT_EQ_FMT((size_t)16, atomic_load(&ks.len), "%zu");
+  for (int i = 1; i < 4; i++) {
+    ASSERT_MEM_EQ(openers[0].ids, openers[i].ids, sizeof(openers[0].ids));
+  }
+
+  size_t id;
+  ASSERT_EQ(keyspace_lookup(&ks, "list-3", &id), 0);
+  ASSERT_EQ_FMT(openers[0].ids[3], id, "%zu");
+  ASSERT_EQ(keyspace_lookup(&ks, "list-16", &id), -1);
+  ASSERT_EQ(keyspace_open(&ks, "a name far too long to fit in the table",
+                          &id),
+            -1);
+
+  worker_pool pool;
+  worker_pool_init(&pool, 4);
+  for (size_t i = 0; i < 160; i++) {
+    worker_pool_submit(&pool, inserter_thread,
+                       (llist_ctx){.keyspace = &ks,
+                                   .list_id = openers[0].ids[i % 16],
+                                   .value = 1 + i});
+  }
+  worker_pool_join(&pool);
+  for (size_t i = 0; i < 16; i++) {
+    ASSERT_EQ_FMT((size_t)10, keyspace_list(&ks, openers[0].ids[i])->len,
+                  "%zu");
+  }
+
+  keyspace_destroy(&ks);
+  PASS();
+}
+
+/* Fork inserters, deleters and searchers working on the same shared list and
+ * check that every process sees the others' changes */
+TEST shm_list_processes(void) {
+  char name[SHM_LIST_NAME_MAX];
+  snprintf(name, sizeof(name), "/mc504-test-%ld", (long)getpid());
+  shm_list *l = shm_list_create(name, 1000);
+  ASSERT(l != NULL);
+  ASSERT_EQ(shm_list_create(name, 1000), NULL);
+
+  /* Two inserters of 500 values each, along with a searcher */
+  pid_t children[3];
+  for (int c = 0; c < 3; c++) {
+    children[c] = fork();
+    if (children[c] == 0) {
+      shm_list *mine = shm_list_attach(name);
+      for (size_t i = 1; mine != NULL && i <= 500; i++) {
+        if (c < 2) {
+          shm_list_insert(mine, (size_t)c * 1000 + i);
+        } else {
+          shm_list_search(mine, i);
+        }
+      }
+      _exit(mine == NULL);
+    }
+  }
+  for (int c = 0; c < 3; c++) {
+    int status;
+    waitpid(children[c], &status, 0);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  ASSERT_EQ_FMT((size_t)1000, shm_list_len(l), "%zu");
+  ASSERT(shm_list_search(l, 500));
+  ASSERT(shm_list_search(l, 1500));
+  ASSERT_EQ(shm_list_insert(l, 2000), -1);
+
+  /* Deleted nodes are reused */
+  pid_t deleter = fork();
+  if (deleter == 0) {
+    shm_list *mine = shm_list_attach(name);
+    for (size_t i = 1; mine != NULL && i <= 500; i += 2) {
+      shm_list_delete(mine, i);
+    }
+    _exit(mine == NULL);
+  }
+  int status;
+  waitpid(deleter, &status, 0);
+  ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  ASSERT_EQ_FMT((size_t)750, shm_list_len(l), "%zu");
+  ASSERT_FALSE(shm_list_search(l, 1));
+  ASSERT(shm_list_search(l, 2));
+  ASSERT_EQ(shm_list_delete(l, 1), 0);
+  ASSERT_EQ(shm_list_insert(l, 2000), 0);
+  ASSERT(shm_list_search(l, 2000));
+
+  shm_list_destroy(l);
+  ASSERT_EQ(shm_list_attach(name), NULL);
+  PASS();
+}
+
+static void *run_server(void *arg) {
+  server_run(arg);
+  return NULL;
+}
+
+static int connect_to(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Read n responses from fd and store their statuses by seq if statuses isn't
+ * NULL, fails if none comes for a second */
+static int read_responses(int fd, size_t n, uint8_t *statuses) {
+  unsigned char buf[PROTOCOL_RESPONSE_SIZE * 256];
+  size_t len = 0;
+  size_t got = 0;
+  while (got < n) {
+    struct pollfd p = {.fd = fd, .events = POLLIN};
+    if (poll(&p, 1, 1000) <= 0) {
+      return -1;
+    }
+    ssize_t r = read(fd, buf + len, sizeof(buf) - len);
+    if (r <= 0) {
+      return -1;
+    }
+    len += (size_t)r;
+    size_t pos = 0;
+    for (; pos + PROTOCOL_RESPONSE_SIZE <= len; pos += PROTOCOL_RESPONSE_SIZE) {
+      protocol_response res;
+      protocol_decode_response(buf + pos, &res);
+      if (statuses != NULL) {
+        statuses[res.seq] = res.status;
+      }
+      got++;
+    }
+    memmove(buf, buf + pos, len - pos);
+    len -= pos;
+  }
+  return 0;
+}
+
+/* Drive the server loop with requests cut across writes, pipelined requests
+ * and a client which sends without ever reading, which the server must stop
+ * reading instead of buffering its responses without bound */
+TEST server_loop(void) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/mc504-test-%ld.sock", (long)getpid());
+  llist *list = llist_new();
+  server s;
+  ASSERT_EQ(server_init(&s, list, path, 2), 0);
+  pthread_t loop;
+  pthread_create(&loop, NULL, run_server, &s);
+  int fd = connect_to(path);
+  ASSERT(fd >= 0);
+
+  /* A request in two writes, with a pause so they arrive apart */
+  struct timespec pause = {.tv_nsec = 10000000};
+  unsigned char buf[PROTOCOL_REQUEST_SIZE * 3];
+  uint8_t statuses[4] = {0};
+  protocol_encode_request(
+      &(protocol_request){.op = PROTOCOL_INSERT, .seq = 0, .key = 5}, buf);
+  ASSERT_EQ(write(fd, buf, 5), 5);
+  nanosleep(&pause, NULL);
+  ASSERT_EQ(write(fd, buf + 5, PROTOCOL_REQUEST_SIZE - 5),
+            PROTOCOL_REQUEST_SIZE - 5);
+  ASSERT_EQ(read_responses(fd, 1, statuses), 0);
+  ASSERT_EQ(statuses[0], PROTOCOL_OK);
+
+  /* Three pipelined requests, the last one cut across two writes */
+  protocol_encode_request(
+      &(protocol_request){.op = PROTOCOL_SEARCH, .seq = 1, .key = 5}, buf);
+  protocol_encode_request(
+      &(protocol_request){.op = PROTOCOL_DELETE, .seq = 2, .key = 7},
+      buf + PROTOCOL_REQUEST_SIZE);
+  protocol_encode_request(
+      &(protocol_request){.op = 9, .seq = 3, .key = 5},
+      buf + 2 * PROTOCOL_REQUEST_SIZE);
+  ASSERT_EQ(write(fd, buf, 2 * PROTOCOL_REQUEST_SIZE + 3),
+            2 * PROTOCOL_REQUEST_SIZE + 3);
+  nanosleep(&pause, NULL);
+  ASSERT_EQ(write(fd, buf + 2 * PROTOCOL_REQUEST_SIZE + 3,
+                  PROTOCOL_REQUEST_SIZE - 3),
+            PROTOCOL_REQUEST_SIZE - 3);
+  ASSERT_EQ(read_responses(fd, 3, statuses), 0);
+  ASSERT_EQ(statuses[1], PROTOCOL_OK);
+  ASSERT_EQ(statuses[2], PROTOCOL_MISS);
+  ASSERT_EQ(statuses[3], PROTOCOL_BAD_REQUEST);
+
+  /* Send until the socket stays full, which only happens if the server stops
+   * reading, then read everything back */
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  size_t sent = 0;
+  while (sent < (size_t)1 << 20) {
+    protocol_encode_request(
+        &(protocol_request){.op = PROTOCOL_SEARCH, .seq = 4, .key = 5}, buf);
+    ssize_t n = send(fd, buf, PROTOCOL_REQUEST_SIZE, 0);
+    if (n == PROTOCOL_REQUEST_SIZE) {
+      sent++;
+      continue;
+    }
+    ASSERT(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    struct pollfd p = {.fd = fd, .events = POLLOUT};
+    if (poll(&p, 1, 200) == 0) {
+      break;
+    }
+  }
+  ASSERT(sent < (size_t)1 << 20);
+  ASSERT_EQ(read_responses(fd, sent, NULL), 0);
+  ASSERT_EQ_FMT(sent + 3, atomic_load(&s.served), "%zu");
+
+  close(fd);
+  server_stop(&s);
+  pthread_join(loop, NULL);
+  server_shutdown(&s);
+  ASSERT_EQ_FMT((size_t)1, s.accepted, "%zu");
+  ASSERT(access(path, F_OK) < 0);
+  llist_free(list);
+  PASS();
+}
+
 SUITE(sync_suite) {
   RUN_TEST(concurrent_inserters);
   RUN_TEST(concurrent_deleters);
@@ -274,6 +1135,278 @@ SUITE(sync_suite) {
   RUN_TEST(inserters_and_searchers);
   RUN_TEST(deleters_and_searchers);
   RUN_TEST(insert_then_delete);
+  RUN_TEST(pool_runs_every_task);
+  RUN_TEST(pool_steals_nested_tasks);
+  RUN_TEST(deque_owner_and_thief_ends);
+  RUN_TEST(executor_runs_coroutines);
+  RUN_TEST(executor_mixed_priorities);
+  RUN_TEST(admission_policies);
+  RUN_TEST(search_batches);
+  RUN_TEST(background_gives_way);
+  RUN_TEST(affinity_policies);
+  RUN_TEST(keyspace_registry);
+  RUN_TEST(shm_list_processes);
+  RUN_TEST(server_loop);
+}
+
+TEST parse_work_models(void) {
+  work_model model;
+
+  ASSERT_EQ(work_parse("none", &model), 0);
+  ASSERT_EQ(model.kind, WORK_NONE);
+  ASSERT_EQ(work_parse("spin:250", &model), 0);
+  ASSERT_EQ(model.kind, WORK_SPIN);
+  ASSERT_EQ_FMT((uint64_t)250, model.ns, "%lu");
+  /* Sleeps are given in microseconds */
+  ASSERT_EQ(work_parse("sleep:3", &model), 0);
+  ASSERT_EQ(model.kind, WORK_SLEEP);
+  ASSERT_EQ_FMT((uint64_t)3000, model.ns, "%lu");
+  ASSERT_EQ(work_parse("exp:10", &model), 0);
+  ASSERT_EQ(model.kind, WORK_EXPONENTIAL);
+
+  ASSERT_EQ(work_parse("spin", &model), -1);
+  ASSERT_EQ(work_parse("spin:", &model), -1);
+  ASSERT_EQ(work_parse("spin:12a", &model), -1);
+  ASSERT_EQ(work_parse("nap:12", &model), -1);
+  /* Invalid specs leave the model untouched */
+  ASSERT_EQ(model.kind, WORK_EXPONENTIAL);
+
+  PASS();
+}
+
+/* With a number of operations, the mix is exact instead of sampled */
+TEST workload_exact_mix(void) {
+  workload wl;
+  workload_gen gen;
+  worker_role role;
+  size_t counts[3] = {0, 0, 0};
+
+  workload_defaults(&wl);
+  ASSERT_EQ(workload_parse_mix("50:30:20", &wl), 0);
+  wl.total_ops = 1001;
+  ASSERT_EQ(workload_validate(&wl), NULL);
+  /* A closed loop counts its outstanding operations with a semaphore */
+  wl.outstanding = (size_t)INT_MAX + 1;
+  ASSERT(workload_validate(&wl) != NULL);
+  wl.outstanding = 0;
+
+  workload_gen_init(&gen, &wl);
+  while (workload_next_role(&gen, &role)) {
+    counts[role]++;
+  }
+  ASSERT_EQ_FMT((size_t)501, counts[ROLE_SEARCHER], "%zu");
+  ASSERT_EQ_FMT((size_t)300, counts[ROLE_INSERTER], "%zu");
+  ASSERT_EQ_FMT((size_t)200, counts[ROLE_DELETER], "%zu");
+
+  PASS();
+}
+
+TEST workload_key_distributions(void) {
+  workload wl;
+  workload_gen gen;
+  size_t hot = 0;
+
+  workload_defaults(&wl);
+  wl.key_range = 100;
+
+  ASSERT_EQ(workload_parse_keys("sequential", &wl), 0);
+  workload_gen_init(&gen, &wl);
+  for (size_t i = 0; i < 250; i++) {
+    ASSERT_EQ_FMT(i % 100 + 1, workload_next_key(&gen), "%zu");
+  }
+
+  ASSERT_EQ(workload_parse_keys("zipfian:0.9", &wl), 0);
+  workload_gen_init(&gen, &wl);
+  for (size_t i = 0; i < 10000; i++) {
+    size_t key = workload_next_key(&gen);
+    ASSERT(key >= 1 && key <= 100);
+    hot += key <= 10;
+  }
+  /* With theta 0.9 the 10 hottest keys get about 60% of the operations */
+  ASSERT(hot > 5000);
+
+  ASSERT_EQ(workload_parse_keys("hotspot:0.1:0.9", &wl), 0);
+  workload_gen_init(&gen, &wl);
+  hot = 0;
+  for (size_t i = 0; i < 10000; i++) {
+    size_t key = workload_next_key(&gen);
+    ASSERT(key >= 1 && key <= 100);
+    hot += key <= 10;
+  }
+  ASSERT(hot > 8500 && hot < 9500);
+
+  ASSERT_EQ(workload_parse_keys("zipfian:", &wl), -1);
+  ASSERT_EQ(workload_parse_keys("hotspot:0.1", &wl), -1);
+  ASSERT_EQ(workload_parse_mix("50:50", &wl), -1);
+  ASSERT_EQ(workload_parse_mix("50:30:30", &wl), 0);
+  ASSERT(workload_validate(&wl) != NULL);
+
+  PASS();
+}
+
+TEST same_seed_same_workload(void) {
+  workload wl;
+  workload_gen a, b;
+  worker_role ra, rb;
+  rng r;
+
+  workload_defaults(&wl);
+  wl.keys = KEYS_ZIPFIAN;
+  wl.seed = 42;
+  workload_gen_init(&a, &wl);
+  workload_gen_init(&b, &wl);
+  while (workload_next_role(&a, &ra)) {
+    ASSERT(workload_next_role(&b, &rb));
+    ASSERT_EQ(ra, rb);
+    ASSERT_EQ_FMT(workload_next_key(&a), workload_next_key(&b), "%zu");
+  }
+  ASSERT_FALSE(workload_next_role(&b, &rb));
+
+  rng_seed(&r, 42, 0);
+  for (uint64_t n = 1; n < 1000; n++) {
+    ASSERT(rng_below(&r, n) < n);
+    double u = rng_unit(&r);
+    ASSERT(u >= 0 && u < 1);
+  }
+
+  PASS();
+}
+
+TEST op_trace_round_trip(void) {
+  llist *list = llist_new();
+  llist_push_back(list, 3);
+  llist_push_back(list, 7);
+
+  op_trace *tr = op_trace_new(list, 2, 1000);
+  op_trace_record(tr, 1, ROLE_INSERTER, 5, 1300);
+  op_trace_record(tr, 0, ROLE_SEARCHER, 7, 1100);
+  op_trace_record(tr, 0, ROLE_DELETER, 3, 1500);
+  ASSERT_EQ(op_trace_write(tr, "build/round-trip.ops"), 0);
+  op_trace_free(tr);
+
+  tr = op_trace_load("build/round-trip.ops");
+  ASSERT(tr != NULL);
+  ASSERT_EQ_FMT((size_t)2, tr->initial_len, "%zu");
+  ASSERT_EQ_FMT((uint64_t)7, tr->initial[1], "%" PRIu64);
+  ASSERT_EQ_FMT((size_t)3, tr->len, "%zu");
+  /* Merged in issue order, with times relative to the start */
+  ASSERT_EQ(tr->ops[0].role, ROLE_SEARCHER);
+  ASSERT_EQ_FMT((uint64_t)100, tr->ops[0].issue_ns, "%" PRIu64);
+  ASSERT_EQ(tr->ops[1].role, ROLE_INSERTER);
+  ASSERT_EQ(tr->ops[1].thread, 1);
+  ASSERT_EQ_FMT((uint64_t)3, tr->ops[2].value, "%" PRIu64);
+  op_trace_free(tr);
+
+  ASSERT_EQ(op_trace_load("test.c"), NULL);
+
+  /* Lengths in the header that don't match the file are rejected before
+   * anything is allocated for them */
+  FILE *f = fopen("build/round-trip.ops", "r+b");
+  uint64_t bogus = UINT64_MAX;
+  ASSERT(f != NULL);
+  fseek(f, 24, SEEK_SET);
+  fwrite(&bogus, sizeof(bogus), 1, f);
+  fclose(f);
+  ASSERT_EQ(op_trace_load("build/round-trip.ops"), NULL);
+
+  remove("build/round-trip.ops");
+  llist_free(list);
+  PASS();
+}
+
+TEST protocol_round_trip(void) {
+  unsigned char buf[PROTOCOL_REQUEST_SIZE];
+  protocol_request req = {
+      .op = PROTOCOL_DELETE, .seq = 0xdeadbeef, .key = UINT64_MAX - 1};
+  protocol_request got;
+  protocol_encode_request(&req, buf);
+  protocol_decode_request(buf, &got);
+  ASSERT_EQ(got.op, PROTOCOL_DELETE);
+  ASSERT_EQ_FMT(req.seq, got.seq, "%" PRIu32);
+  ASSERT_EQ_FMT(req.key, got.key, "%" PRIu64);
+  /* Padding is ignored */
+  buf[1] = 0xff;
+  protocol_decode_request(buf, &got);
+  ASSERT_EQ_FMT(req.key, got.key, "%" PRIu64);
+
+  protocol_response res = {.seq = 42, .status = PROTOCOL_MISS};
+  protocol_response res_got;
+  protocol_encode_response(&res, buf);
+  protocol_decode_response(buf, &res_got);
+  ASSERT_EQ_FMT((uint32_t)42, res_got.seq, "%" PRIu32);
+  ASSERT_EQ(res_got.status, PROTOCOL_MISS);
+  ASSERT_EQ(buf[5], 0);
+  PASS();
+}
+
+TEST histogram_percentiles(void) {
+  histogram *h = calloc(2, sizeof(histogram));
+
+  ASSERT_EQ_FMT((uint64_t)0, histogram_percentile(&h[0], 50), "%" PRIu64);
+  for (uint64_t v = 1; v <= 10000; v++) {
+    histogram_record(&h[v % 2], v * 1000);
+  }
+  histogram_merge(&h[0], &h[1]);
+  ASSERT_EQ_FMT((uint64_t)10000, h[0].count, "%" PRIu64);
+  ASSERT_EQ_FMT((uint64_t)10000000, h[0].max, "%" PRIu64);
+
+  /* Buckets keep values within 1/32 of the exact percentile */
+  double pcts[] = {50, 99, 99.9};
+  for (int i = 0; i < 3; i++) {
+    double exact = pcts[i] * 1e5;
+    double got = (double)histogram_percentile(&h[0], pcts[i]);
+    ASSERT(got >= exact && got <= exact * (1 + 1.0 / 32));
+  }
+  ASSERT_EQ_FMT((uint64_t)10000000, histogram_percentile(&h[0], 100),
+                "%" PRIu64);
+
+  free(h);
+  PASS();
+}
+
+/* Operations issued during the warmup run but stay out of the statistics */
+TEST warmup_is_excluded(void) {
+  workload wl;
+  workload_defaults(&wl);
+  wl.total_ops = 60;
+  wl.seed = 7;
+
+  for (int warm = 0; warm < 2; warm++) {
+    run_cfg run = run_cfg_new(&wl);
+    run.quiet = 1;
+    run.threads = 3;
+    /* Long enough for the whole run to be warmup */
+    run.warmup = warm ? 60 : 0;
+    run.record_path = "build/warmup.ops";
+    run_cfg_run(&run);
+    /* The trace has every operation, or it couldn't be replayed */
+    op_trace *tr = op_trace_load("build/warmup.ops");
+    ASSERT(tr != NULL);
+    ASSERT_EQ_FMT((size_t)60, tr->len, "%zu");
+    op_trace_free(tr);
+    remove("build/warmup.ops");
+
+    size_t measured = 0;
+    for (int r = 0; r < 3; r++) {
+      measured += run.latency[r].count;
+    }
+    ASSERT_EQ_FMT(warm ? (size_t)0 : (size_t)60, measured, "%zu");
+    ASSERT_EQ_FMT(warm ? (size_t)60 : (size_t)0,
+                  atomic_load(&run.warmup_ops), "%zu");
+    ASSERT(warm ? run.elapsed_ns == 0 : run.elapsed_ns > 0);
+  }
+  PASS();
+}
+
+SUITE(work_suite) {
+  RUN_TEST(parse_work_models);
+  RUN_TEST(workload_exact_mix);
+  RUN_TEST(workload_key_distributions);
+  RUN_TEST(same_seed_same_workload);
+  RUN_TEST(op_trace_round_trip);
+  RUN_TEST(protocol_round_trip);
+  RUN_TEST(histogram_percentiles);
+  RUN_TEST(warmup_is_excluded);
 }
 
 /* Add definitions that need to be in the test runner's main file. */
@@ -284,6 +1417,7 @@ int main(int argc, char **argv) {
 
   RUN_SUITE(llist_suite);
   RUN_SUITE(sync_suite);
+  RUN_SUITE(work_suite);
 
   GREATEST_MAIN_END(); /* display results */
 }